@@ -38,6 +38,11 @@
 
 #include <string>
 #include <cstddef>    // std::size_t
+#include <climits>    // INT_MIN
+#include <cfloat>     // FLT_MAX
+#include <cmath>      // std::isfinite, std::signbit
+#include <cstdlib>    // std::strtoll, std::strtof
+#include <utility>    // std::swap
 
 // uncomment the following line to enable debugging messages with DEBUG*
 // #define DEBUG_BUILD
@@ -49,10 +54,23 @@
 // Constructor
 CodeGenVisitor::CodeGenVisitor(TypesMgr       & Types,
                                SymTable       & Symbols,
-                               TreeDecoration & Decorations) :
+                               TreeDecoration & Decorations,
+                               bool             FoldConstants,
+                               bool             ShortCircuit,
+                               bool             BlockCopy,
+                               bool             StringPool,
+                               bool             Immediates,
+                               bool             CompareJumps) :
   Types{Types},
   Symbols{Symbols},
-  Decorations{Decorations} {
+  Decorations{Decorations},
+  FoldConstants{FoldConstants},
+  ShortCircuit{ShortCircuit},
+  BlockCopy{BlockCopy},
+  StringPool{StringPool},
+  Immediates{Immediates},
+  CompareJumps{CompareJumps},
+  Program{nullptr} {
 }
 
 // Methods to visit each kind of node:
@@ -60,6 +78,7 @@ CodeGenVisitor::CodeGenVisitor(TypesMgr       & Types,
 antlrcpp::Any CodeGenVisitor::visitProgram(AslParser::ProgramContext *ctx) {
   DEBUG_ENTER();
   code my_code;
+  Program = &my_code;
   SymTable::ScopeId sc = getScopeDecor(ctx);
   Symbols.pushThisScope(sc);
   for (auto ctxFunc : ctx->function()) {
@@ -67,6 +86,7 @@ antlrcpp::Any CodeGenVisitor::visitProgram(AslParser::ProgramContext *ctx) {
     my_code.add_subroutine(subr);
   }
   Symbols.popScope();
+  Program = nullptr;
   DEBUG_EXIT();
   return my_code;
 }
@@ -141,26 +161,34 @@ antlrcpp::Any CodeGenVisitor::visitAssignStmt(AslParser::AssignStmtContext *ctx)
   DEBUG_ENTER();
   instructionList code;
   CodeAttribs     && codAtsE1 = visit(ctx->left_expr());
-  std::string           addr1 = codAtsE1.addr;
-  std::string           offs1 = codAtsE1.offs;
+  operand               addr1 = codAtsE1.addr;
+  operand               offs1 = codAtsE1.offs;
   instructionList &     code1 = codAtsE1.code;
   TypesMgr::TypeId t1 = getTypeDecor(ctx->left_expr());
-  CodeAttribs     && codAtsE2 = visit(ctx->expr());
-  std::string           addr2 = codAtsE2.addr;
-  // std::string           offs2 = codAtsE2.offs;
-  instructionList &     code2 = codAtsE2.code;
   TypesMgr::TypeId t2 = getTypeDecor(ctx->expr());
+  bool toElement = ctx->left_expr()->array_element() != nullptr;
+  CodeAttribs     && codAtsE2 = (toElement ?
+                                   visitOperand(ctx->expr(), Types.isFloatTy(t1)) :
+                                   visit(ctx->expr()));
+  operand               addr2 = codAtsE2.addr;
+  // operand               offs2 = codAtsE2.offs;
+  instructionList &     code2 = codAtsE2.code;
   code = code1 || code2;
 
 
-  if (ctx->left_expr()->array_element()) {
-    if (Types.isFloatTy(t1) and Types.isIntegerTy(t2)) {
+  if (toElement) {
+    if (Types.isFloatTy(t1) and Types.isIntegerTy(t2) and not addr2.is_const()) {
       // floatTemp = float addr2
       // addr1[offs1] = floatTemp
-      std::string floatTemp = "%"+codeCounters.newTEMP();
-      code = code ||
-             instruction::FLOAT(floatTemp, addr2) ||
-             instruction::XLOAD(addr1, offs1, floatTemp);
+      operand floatTemp = codeCounters.newTEMP();
+      if (isFoldable(ctx->expr()))
+        code = code1 ||
+               loadAsFloat(floatTemp, ctx->expr()) ||
+               instruction::XLOAD(addr1, offs1, floatTemp);
+      else
+        code = code ||
+               instruction::FLOAT(floatTemp, addr2) ||
+               instruction::XLOAD(addr1, offs1, floatTemp);
     }
     else {
       // addr1[offs1] = addr2
@@ -170,25 +198,69 @@ antlrcpp::Any CodeGenVisitor::visitAssignStmt(AslParser::AssignStmtContext *ctx)
 
   else if (Types.isArrayTy(t1) and Types.isArrayTy(t2)) {
     int arraySize = Types.getArraySize(t1);
-    std::string offsTemp = "%"+codeCounters.newTEMP();
-    std::string elemTemp = "%"+codeCounters.newTEMP();
-    std::string addr1Temp = addr1;
-    std::string addr2Temp = addr2;
-    if (Symbols.isParameterClass(addr1)) {
-      addr1Temp = "%"+codeCounters.newTEMP();
+    operand addr1Temp = addr1;
+    operand addr2Temp = addr2;
+    if (Symbols.isParameterClass(addr1.get_name())) {
+      addr1Temp = codeCounters.newTEMP();
       code = code ||
              instruction::LOAD(addr1Temp, addr1); // temp = arrayIdent (NECESARIO)
     }
-    if (Symbols.isParameterClass(addr2)) {
-      addr2Temp = "%"+codeCounters.newTEMP();
+    if (Symbols.isParameterClass(addr2.get_name())) {
+      addr2Temp = codeCounters.newTEMP();
       code = code ||
              instruction::LOAD(addr2Temp, addr2); // temp = arrayIdent (NECESARIO)
     }
-    for (int i = 0; i < arraySize; ++i) { //copia por valor. ES POR REFERENCIA??? (sería asignar puntero)
+    if (BlockCopy) {
+      // acopy addr1 addr2 size
+      operand sizeTemp = codeCounters.newTEMP();
       code = code ||
-             instruction::ILOAD(offsTemp, std::to_string(i)) ||
+             instruction::ILOAD(sizeTemp, arraySize) ||
+             instruction::ACOPY(addr1Temp, addr2Temp, sizeTemp);
+    }
+    else if (arraySize <= 3) {
+      // a loop is not shorter
+      operand offsTemp;
+      if (not Immediates)
+        offsTemp = codeCounters.newTEMP();
+      operand elemTemp = codeCounters.newTEMP();
+      for (int i = 0; i < arraySize; ++i) { //copia por valor. ES POR REFERENCIA??? (sería asignar puntero)
+        operand offs = offsTemp;
+        if (Immediates)
+          offs = operand::INTCONST(i);
+        else
+          code = code || instruction::ILOAD(offsTemp, i);
+        code = code ||
+               instruction::LOADX(elemTemp, addr2Temp, offs) ||
+               instruction::XLOAD(addr1Temp, offs, elemTemp);
+      }
+    }
+    else {
+      // offs = 0
+      // label copyN :
+      //   addr1[offs] = addr2[offs]
+      //   offs = offs + 1
+      //   ifFalse size <= offs goto copyN
+      operand offsTemp = codeCounters.newTEMP();
+      operand elemTemp = codeCounters.newTEMP();
+      operand sizeTemp = operand::INTCONST(arraySize);
+      operand oneTemp  = operand::INTCONST(1);
+      operand condTemp = codeCounters.newTEMP();
+      std::string label = "copy" + codeCounters.newLabelCOPY();
+      code = code || instruction::ILOAD(offsTemp, 0);
+      if (not Immediates) {
+        sizeTemp = codeCounters.newTEMP();
+        oneTemp  = codeCounters.newTEMP();
+        code = code ||
+               instruction::ILOAD(sizeTemp, arraySize) ||
+               instruction::ILOAD(oneTemp, 1);
+      }
+      code = code ||
+             instruction::LABEL(label) ||
              instruction::LOADX(elemTemp, addr2Temp, offsTemp) ||
-             instruction::XLOAD(addr1Temp, offsTemp, elemTemp);
+             instruction::XLOAD(addr1Temp, offsTemp, elemTemp) ||
+             instruction::ADD(offsTemp, offsTemp, oneTemp) ||
+             instruction::LE(condTemp, sizeTemp, offsTemp) ||
+             instruction::FJUMP(condTemp, label);
     }
 
   }
@@ -196,10 +268,15 @@ antlrcpp::Any CodeGenVisitor::visitAssignStmt(AslParser::AssignStmtContext *ctx)
     if (Types.isFloatTy(t1) and Types.isIntegerTy(t2)) {
       // floatTemp = float addr2
       // addr1 = floatTemp
-      std::string floatTemp = "%"+codeCounters.newTEMP();
-      code = code ||
-             instruction::FLOAT(floatTemp, addr2) ||
-             instruction::LOAD(addr1, floatTemp);
+      operand floatTemp = codeCounters.newTEMP();
+      if (isFoldable(ctx->expr()))
+        code = code1 ||
+               loadAsFloat(floatTemp, ctx->expr()) ||
+               instruction::LOAD(addr1, floatTemp);
+      else
+        code = code ||
+               instruction::FLOAT(floatTemp, addr2) ||
+               instruction::LOAD(addr1, floatTemp);
     }
     else {
       // addr1 = addr2
@@ -213,8 +290,33 @@ antlrcpp::Any CodeGenVisitor::visitAssignStmt(AslParser::AssignStmtContext *ctx)
 antlrcpp::Any CodeGenVisitor::visitWhileStmt(AslParser::WhileStmtContext *ctx) {
   DEBUG_ENTER();
   instructionList code;
+  if (isFoldable(ctx->expr())) {
+    // known condition: the loop never runs, or it needs no test
+    if (getConstantDecor(ctx->expr()).ival) {
+      instructionList && code2 = visit(ctx->statements()); // DO Statements
+      std::string labelWhile = "while"+codeCounters.newLabelWHILE();
+      code = instruction::LABEL(labelWhile) ||
+             code2 ||
+             instruction::UJUMP(labelWhile);
+    }
+    DEBUG_EXIT();
+    return code;
+  }
+  if (ShortCircuit or comparison(ctx->expr())) {
+    instructionList &&   code2 = visit(ctx->statements()); // DO Statements
+    std::string whileNum = codeCounters.newLabelWHILE();
+    std::string labelWhile = "while"+whileNum;
+    std::string labelEndWhile = "endwhile"+whileNum;
+    code = instruction::LABEL(labelWhile) ||
+           codeCondition(ctx->expr(), labelEndWhile, false) ||
+           code2 ||
+           instruction::UJUMP(labelWhile) ||
+           instruction::LABEL(labelEndWhile);
+    DEBUG_EXIT();
+    return code;
+  }
   CodeAttribs     && codAtsE = visit(ctx->expr());
-  std::string          addr1 = codAtsE.addr;
+  operand              addr1 = codAtsE.addr;
   instructionList &    code1 = codAtsE.code;
   instructionList &&   code2 = visit(ctx->statements()); // DO Statements
   std::string whileNum = codeCounters.newLabelWHILE();
@@ -235,8 +337,43 @@ antlrcpp::Any CodeGenVisitor::visitWhileStmt(AslParser::WhileStmtContext *ctx) {
 antlrcpp::Any CodeGenVisitor::visitIfStmt(AslParser::IfStmtContext *ctx) {
   DEBUG_ENTER();
   instructionList code;
+  if (isFoldable(ctx->expr())) {
+    // known condition: only the branch that is taken
+    if (getConstantDecor(ctx->expr()).ival) {
+      instructionList && code2 = visit(ctx->statements(0)); // THEN Statements
+      code = code2;
+    }
+    else if (ctx->ELSE()) {
+      instructionList && code3 = visit(ctx->statements(1)); // ELSE Statements
+      code = code3;
+    }
+    DEBUG_EXIT();
+    return code;
+  }
+  if (ShortCircuit or comparison(ctx->expr())) {
+    instructionList &&   code2 = visit(ctx->statements(0)); // THEN Statements
+    std::string label = codeCounters.newLabelIF();
+    std::string labelEndIf = "endif"+label;
+    std::string labelElse = "else"+label;
+    if (ctx->ELSE()) {
+      instructionList &&   code3 = visit(ctx->statements(1)); // ELSE Statements
+      code = codeCondition(ctx->expr(), labelElse, false) ||
+             code2 ||
+             instruction::UJUMP(labelEndIf) ||
+             instruction::LABEL(labelElse) ||
+             code3 ||
+             instruction::LABEL(labelEndIf);
+    }
+    else {
+      code = codeCondition(ctx->expr(), labelEndIf, false) ||
+             code2 ||
+             instruction::LABEL(labelEndIf);
+    }
+    DEBUG_EXIT();
+    return code;
+  }
   CodeAttribs     && codAtsE = visit(ctx->expr());
-  std::string          addr1 = codAtsE.addr;
+  operand              addr1 = codAtsE.addr;
   instructionList &    code1 = codAtsE.code;
   instructionList &&   code2 = visit(ctx->statements(0)); // THEN Statements
   //instructionList &&   code3 = visit(ctx->statements(1)); // ELSE Statements
@@ -276,14 +413,23 @@ antlrcpp::Any CodeGenVisitor::visitProcCall(AslParser::ProcCallContext *ctx) {
   int i = 0;
   while (ctx->expr(i)) {
     CodeAttribs     && codAt1 = visit(ctx->expr(i));
-    std::string         addr1 = codAt1.addr;
+    operand             addr1 = codAt1.addr;
     instructionList &   code1 = codAt1.code;
-    code = code || code1;
     TypesMgr::TypeId tExpr = getTypeDecor(ctx->expr(i));
     TypesMgr::TypeId tParam = Types.getParameterType(tFunc, i);
+    if (Types.isIntegerTy(tExpr) and Types.isFloatTy(tParam) and isFoldable(ctx->expr(i))) {
+      // float immediate instead of the coercion
+      operand floatTemp = codeCounters.newTEMP();
+      code = code ||
+             loadAsFloat(floatTemp, ctx->expr(i)) ||
+             instruction::PUSH(floatTemp);
+      ++i;
+      continue;
+    }
+    code = code || code1;
     if (Types.isIntegerTy(tExpr) and Types.isFloatTy(tParam)) {
       // coercion float -> int
-      std::string floatTemp = "%"+codeCounters.newTEMP();
+      operand floatTemp = codeCounters.newTEMP();
       code = code ||
              instruction::FLOAT(floatTemp, addr1) ||
              instruction::PUSH(floatTemp);
@@ -291,7 +437,7 @@ antlrcpp::Any CodeGenVisitor::visitProcCall(AslParser::ProcCallContext *ctx) {
     else {
       if (Types.isArrayTy(tExpr)) {
         // push array reference
-        std::string refTemp = "%"+codeCounters.newTEMP();
+        operand refTemp = codeCounters.newTEMP();
         code = code ||
                instruction::ALOAD(refTemp, addr1) ||
                instruction::PUSH(refTemp);
@@ -317,15 +463,15 @@ antlrcpp::Any CodeGenVisitor::visitProcCall(AslParser::ProcCallContext *ctx) {
 antlrcpp::Any CodeGenVisitor::visitReadStmt(AslParser::ReadStmtContext *ctx) {
   DEBUG_ENTER();
   CodeAttribs     && codAtsE = visit(ctx->left_expr());
-  std::string          addr1 = codAtsE.addr;
-  std::string          offs1 = codAtsE.offs;
+  operand              addr1 = codAtsE.addr;
+  operand              offs1 = codAtsE.offs;
   instructionList &    code1 = codAtsE.code;
 
   instructionList &     code = code1;
   TypesMgr::TypeId tid1 = getTypeDecor(ctx->left_expr());
-  std::string temp = addr1;
+  operand temp = addr1;
   if (ctx->left_expr()->array_element()) {
-    temp = "%"+codeCounters.newTEMP();
+    temp = codeCounters.newTEMP();
   }
   if (Types.isIntegerTy(tid1) or Types.isBooleanTy(tid1))
     code = code || instruction::READI(temp);
@@ -347,8 +493,8 @@ antlrcpp::Any CodeGenVisitor::visitReadStmt(AslParser::ReadStmtContext *ctx) {
 antlrcpp::Any CodeGenVisitor::visitWriteExpr(AslParser::WriteExprContext *ctx) {
   DEBUG_ENTER();
   CodeAttribs     && codAt1 = visit(ctx->expr());
-  std::string         addr1 = codAt1.addr;
-  // std::string         offs1 = codAt1.offs;
+  operand             addr1 = codAt1.addr;
+  // operand             offs1 = codAt1.offs;
   instructionList &   code1 = codAt1.code;
   instructionList &    code = code1;
   TypesMgr::TypeId tExpr = getTypeDecor(ctx->expr());
@@ -366,12 +512,31 @@ antlrcpp::Any CodeGenVisitor::visitWriteString(AslParser::WriteStringContext *ct
   DEBUG_ENTER();
   instructionList code;
   std::string s = ctx->STRING()->getText();
-  std::string temp = "%"+codeCounters.newTEMP();
+  if (StringPool) {
+    // writes N, with the escapes of the literal already replaced
+    std::string text;
+    for (int i = 1; i < int(s.size())-1; ++i) {
+      if (s[i] == '\\' and i < int(s.size())-2 and
+          (s[i+1] == 'n' or s[i+1] == 't' or s[i+1] == '"' or s[i+1] == '\\')) {
+        ++i;
+        text += (s[i] == 'n' ? '\n' : s[i] == 't' ? '\t' : s[i]);
+      }
+      else
+        text += s[i];
+    }
+    if (text == "\n")
+      code = instruction::WRITELN();
+    else if (not text.empty())
+      code = instruction::WRITES(operand::INTCONST(Program->add_string(text)));
+    DEBUG_EXIT();
+    return code;
+  }
+  operand temp = codeCounters.newTEMP();
   int i = 1;
   while (i < int(s.size())-1) {
     if (s[i] != '\\') {
       code = code ||
-	     instruction::CHLOAD(temp, s.substr(i,1)) ||
+	     instruction::CHLOAD(temp, s[i]) ||
 	     instruction::WRITEC(temp);
       i += 1;
     }
@@ -383,13 +548,13 @@ antlrcpp::Any CodeGenVisitor::visitWriteString(AslParser::WriteStringContext *ct
       }
       else if (s[i+1] == 't' or s[i+1] == '"' or s[i+1] == '\\') {
         code = code ||
-               instruction::CHLOAD(temp, s.substr(i,2)) ||
+               instruction::CHLOAD(temp, s[i+1] == 't' ? '\t' : s[i+1]) ||
 	       instruction::WRITEC(temp);
         i += 2;
       }
       else {
         code = code ||
-               instruction::CHLOAD(temp, s.substr(i,1)) ||
+               instruction::CHLOAD(temp, s[i]) ||
 	       instruction::WRITEC(temp);
         i += 1;
       }
@@ -408,16 +573,16 @@ antlrcpp::Any CodeGenVisitor::visitLeft_expr(AslParser::Left_exprContext *ctx) {
   }
   else { // array_element
     std::string arrayIdent = ctx->array_element()->ident()->getText();
-    CodeAttribs     && codAtExpr = visit(ctx->array_element()->expr());
-    std::string         addrExpr = codAtExpr.addr;
+    CodeAttribs     && codAtExpr = visitOperand(ctx->array_element()->expr());
+    operand             addrExpr = codAtExpr.addr;
     instructionList &   codeExpr = codAtExpr.code;
     instructionList code;
-    std::string temp = arrayIdent;
+    operand temp = operand::NAME(arrayIdent);
     code = codeExpr;
     if (Symbols.isParameterClass(arrayIdent)) {
-      temp = "%"+codeCounters.newTEMP();
+      temp = codeCounters.newTEMP();
       code = code ||
-             instruction::LOAD(temp, arrayIdent); // temp = arrayIdent (NECESARIO)
+             instruction::LOAD(temp, operand::NAME(arrayIdent)); // temp = arrayIdent (NECESARIO)
     }
     CodeAttribs codAts(temp, addrExpr, code);
     DEBUG_EXIT();
@@ -434,15 +599,16 @@ antlrcpp::Any CodeGenVisitor::visitParenthesisExpr(AslParser::ParenthesisExprCon
 }
 
 antlrcpp::Any CodeGenVisitor::visitArithmeticUnary(AslParser::ArithmeticUnaryContext *ctx) {
+  if (isFoldable(ctx)) return visitFoldedExpr(ctx);
   CodeAttribs     && codAt1 = visit(ctx->expr());
-  std::string         addr1 = codAt1.addr;
+  operand             addr1 = codAt1.addr;
   instructionList &   code1 = codAt1.code;
   instructionList &&   code = code1 || instructionList();
 
   TypesMgr::TypeId t1 = getTypeDecor(ctx->expr());
   //TypesMgr::TypeId  t = getTypeDecor(ctx);
 
-  std::string temp = "%"+codeCounters.newTEMP();
+  operand temp = codeCounters.newTEMP();
   if (ctx->PLUS())
     temp = addr1;
   else if (ctx->SUB()) {
@@ -454,41 +620,43 @@ antlrcpp::Any CodeGenVisitor::visitArithmeticUnary(AslParser::ArithmeticUnaryCon
     }
   }
 
-  CodeAttribs codAts(temp, "", code);
+  CodeAttribs codAts(temp, operand(), code);
   DEBUG_EXIT();
   return codAts;
 }
 
 antlrcpp::Any CodeGenVisitor::visitBooleanUnary(AslParser::BooleanUnaryContext *ctx) {
+  if (isFoldable(ctx)) return visitFoldedExpr(ctx);
   CodeAttribs     && codAt1 = visit(ctx->expr());
-  std::string         addr1 = codAt1.addr;
+  operand             addr1 = codAt1.addr;
   instructionList &   code1 = codAt1.code;
   instructionList &&   code = code1 || instructionList();
   // TypesMgr::TypeId t1 = getTypeDecor(ctx->expr());
   // TypesMgr::TypeId  t = getTypeDecor(ctx);
-  std::string temp = "%"+codeCounters.newTEMP();
+  operand temp = codeCounters.newTEMP();
   if (ctx->NOT())
     code = code || instruction::NOT(temp, addr1);
 
-  CodeAttribs codAts(temp, "", code);
+  CodeAttribs codAts(temp, operand(), code);
   DEBUG_EXIT();
   return codAts;
 }
 
 antlrcpp::Any CodeGenVisitor::visitArithmeticBinary(AslParser::ArithmeticBinaryContext *ctx) {
+  if (isFoldable(ctx)) return visitFoldedExpr(ctx);
   DEBUG_ENTER();
-  CodeAttribs     && codAt1 = visit(ctx->expr(0));
-  std::string         addr1 = codAt1.addr;
+  TypesMgr::TypeId t1 = getTypeDecor(ctx->expr(0));
+  TypesMgr::TypeId t2 = getTypeDecor(ctx->expr(1));
+  bool floats = not (Types.isIntegerTy(t1) and Types.isIntegerTy(t2));
+  CodeAttribs     && codAt1 = visitOperand(ctx->expr(0), floats);
+  operand             addr1 = codAt1.addr;
   instructionList &   code1 = codAt1.code;
-  CodeAttribs     && codAt2 = visit(ctx->expr(1));
-  std::string         addr2 = codAt2.addr;
+  CodeAttribs     && codAt2 = visitOperand(ctx->expr(1), floats);
+  operand             addr2 = codAt2.addr;
   instructionList &   code2 = codAt2.code;
   instructionList &&   code = code1 || code2;
-
-  TypesMgr::TypeId t1 = getTypeDecor(ctx->expr(0));
-  TypesMgr::TypeId t2 = getTypeDecor(ctx->expr(1));
   // TypesMgr::TypeId  t = getTypeDecor(ctx);
-  std::string temp = "%"+codeCounters.newTEMP();
+  operand temp = codeCounters.newTEMP();
   if (Types.isIntegerTy(t1) and Types.isIntegerTy(t2)) {
     if (ctx->MUL())
       code = code || instruction::MUL(temp, addr1, addr2);
@@ -499,25 +667,31 @@ antlrcpp::Any CodeGenVisitor::visitArithmeticBinary(AslParser::ArithmeticBinaryC
     else if (ctx->SUB())
       code = code || instruction::SUB(temp, addr1, addr2);
     else if (ctx->MOD()) {
-      std::string divTemp = "%"+codeCounters.newTEMP();
-      std::string mulTemp = "%"+codeCounters.newTEMP();
+      operand divTemp = codeCounters.newTEMP();
+      operand mulTemp = codeCounters.newTEMP();
       code = code || instruction::DIV(divTemp, addr1, addr2) ||
              instruction::MUL(mulTemp, divTemp, addr2) ||
              instruction::SUB(temp, addr1, mulTemp);
     }
   }
   else { // Some float
-    std::string temp1 = addr1;
-    std::string temp2 = addr2;
-    if (Types.isIntegerTy(t1)) {
-      temp1 = "%"+codeCounters.newTEMP();
-      code = code ||
-             instruction::FLOAT(temp1, addr1);
+    operand temp1 = addr1;
+    operand temp2 = addr2;
+    if (Types.isIntegerTy(t1) and not addr1.is_const()) {
+      temp1 = codeCounters.newTEMP();
+      if (isFoldable(ctx->expr(0)))
+        code = loadAsFloat(temp1, ctx->expr(0)) || code2;
+      else
+        code = code ||
+               instruction::FLOAT(temp1, addr1);
     }
-    else if (Types.isIntegerTy(t2)) {
-      temp2 = "%"+codeCounters.newTEMP();
-      code = code ||
-             instruction::FLOAT(temp2, addr2);
+    else if (Types.isIntegerTy(t2) and not addr2.is_const()) {
+      temp2 = codeCounters.newTEMP();
+      if (isFoldable(ctx->expr(1)))
+        code = code1 || loadAsFloat(temp2, ctx->expr(1));
+      else
+        code = code ||
+               instruction::FLOAT(temp2, addr2);
     }
     if (ctx->MUL())
       code = code || instruction::FMUL(temp, temp1, temp2);
@@ -529,24 +703,25 @@ antlrcpp::Any CodeGenVisitor::visitArithmeticBinary(AslParser::ArithmeticBinaryC
       code = code || instruction::FSUB(temp, temp1, temp2);
   }
 
-  CodeAttribs codAts(temp, "", code);
+  CodeAttribs codAts(temp, operand(), code);
   DEBUG_EXIT();
   return codAts;
 }
 
 antlrcpp::Any CodeGenVisitor::visitRelational(AslParser::RelationalContext *ctx) {
+  if (isFoldable(ctx)) return visitFoldedExpr(ctx);
   DEBUG_ENTER();
-  CodeAttribs     && codAt1 = visit(ctx->expr(0));
-  std::string         addr1 = codAt1.addr;
-  instructionList &   code1 = codAt1.code;
-  CodeAttribs     && codAt2 = visit(ctx->expr(1));
-  std::string         addr2 = codAt2.addr;
-  instructionList &   code2 = codAt2.code;
-  instructionList &&   code = code1 || code2;
   TypesMgr::TypeId t1 = getTypeDecor(ctx->expr(0));
   TypesMgr::TypeId t2 = getTypeDecor(ctx->expr(1));
-  // TypesMgr::TypeId  t = getTypeDecor(ctx);
-  std::string temp = "%"+codeCounters.newTEMP();
+  bool floats = not (Types.isIntegerTy(t1) and Types.isIntegerTy(t2));
+  CodeAttribs     && codAt1 = visitOperand(ctx->expr(0), floats);
+  operand             addr1 = codAt1.addr;
+  instructionList &   code1 = codAt1.code;
+  CodeAttribs     && codAt2 = visitOperand(ctx->expr(1), floats);
+  operand             addr2 = codAt2.addr;
+  instructionList &   code2 = codAt2.code;
+  instructionList &&   code = code1 || code2;  // TypesMgr::TypeId  t = getTypeDecor(ctx);
+  operand temp = codeCounters.newTEMP();
   if (Types.isIntegerTy(t1) and Types.isIntegerTy(t2)) {
     if (ctx->EQUAL())
       code = code || instruction::EQ(temp, addr1, addr2);
@@ -562,17 +737,23 @@ antlrcpp::Any CodeGenVisitor::visitRelational(AslParser::RelationalContext *ctx)
       code = code || instruction::LE(temp, addr1, addr2);
   }
   else { // Some float
-    std::string temp1 = addr1;
-    std::string temp2 = addr2;
-    if (Types.isIntegerTy(t1)) {
-      temp1 = "%"+codeCounters.newTEMP();
-      code = code ||
-             instruction::FLOAT(temp1, addr1);
+    operand temp1 = addr1;
+    operand temp2 = addr2;
+    if (Types.isIntegerTy(t1) and not addr1.is_const()) {
+      temp1 = codeCounters.newTEMP();
+      if (isFoldable(ctx->expr(0)))
+        code = loadAsFloat(temp1, ctx->expr(0)) || code2;
+      else
+        code = code ||
+               instruction::FLOAT(temp1, addr1);
     }
-    else if (Types.isIntegerTy(t2)) {
-      temp2 = "%"+codeCounters.newTEMP();
-      code = code ||
-             instruction::FLOAT(temp2, addr2);
+    else if (Types.isIntegerTy(t2) and not addr2.is_const()) {
+      temp2 = codeCounters.newTEMP();
+      if (isFoldable(ctx->expr(1)))
+        code = code1 || loadAsFloat(temp2, ctx->expr(1));
+      else
+        code = code ||
+               instruction::FLOAT(temp2, addr2);
     }
     if (ctx->EQUAL())
       code = code || instruction::FEQ(temp, temp1, temp2);
@@ -587,30 +768,31 @@ antlrcpp::Any CodeGenVisitor::visitRelational(AslParser::RelationalContext *ctx)
     else if (ctx->LEQ())
       code = code || instruction::FLE(temp, temp1, temp2);
   }
-  CodeAttribs codAts(temp, "", code);
+  CodeAttribs codAts(temp, operand(), code);
   DEBUG_EXIT();
   return codAts;
 }
 
 antlrcpp::Any CodeGenVisitor::visitBooleanBinary(AslParser::BooleanBinaryContext *ctx) {
+  if (isFoldable(ctx)) return visitFoldedExpr(ctx);
   DEBUG_ENTER();
   CodeAttribs     && codAt1 = visit(ctx->expr(0));
-  std::string         addr1 = codAt1.addr;
+  operand             addr1 = codAt1.addr;
   instructionList &   code1 = codAt1.code;
   CodeAttribs     && codAt2 = visit(ctx->expr(1));
-  std::string         addr2 = codAt2.addr;
+  operand             addr2 = codAt2.addr;
   instructionList &   code2 = codAt2.code;
   instructionList &&   code = code1 || code2;
   // TypesMgr::TypeId t1 = getTypeDecor(ctx->expr(0));
   // TypesMgr::TypeId t2 = getTypeDecor(ctx->expr(1));
   // TypesMgr::TypeId  t = getTypeDecor(ctx);
-  std::string temp = "%"+codeCounters.newTEMP();
+  operand temp = codeCounters.newTEMP();
   if (ctx->AND())
     code = code || instruction::AND(temp, addr1, addr2);
   else if (ctx->OR())
     code = code || instruction::OR(temp, addr1, addr2);
 
-  CodeAttribs codAts(temp, "", code);
+  CodeAttribs codAts(temp, operand(), code);
   DEBUG_EXIT();
   return codAts;
 }
@@ -619,46 +801,42 @@ antlrcpp::Any CodeGenVisitor::visitArrayValue(AslParser::ArrayValueContext *ctx)
   DEBUG_ENTER();
   instructionList code;
   std::string arrayIdent = ctx->array_element()->ident()->getText();
-  CodeAttribs     && codAt1 = visit(ctx->array_element()->expr());
-  std::string         addr1 = codAt1.addr;
+  CodeAttribs     && codAt1 = visitOperand(ctx->array_element()->expr());
+  operand             addr1 = codAt1.addr;
   instructionList &   code1 = codAt1.code;
-  std::string temp = "%"+codeCounters.newTEMP();
-  std::string arrayTemp = arrayIdent;
+  operand temp = codeCounters.newTEMP();
+  operand arrayTemp = operand::NAME(arrayIdent);
   code = code1;
   if (Symbols.isParameterClass(arrayIdent)) {
-    arrayTemp = "%"+codeCounters.newTEMP();
+    arrayTemp = codeCounters.newTEMP();
     code = code ||
-           instruction::LOAD(arrayTemp, arrayIdent); // temp = arrayIdent (NECESARIO)
+           instruction::LOAD(arrayTemp, operand::NAME(arrayIdent)); // temp = arrayIdent (NECESARIO)
   }
   code = code ||
          instruction::LOADX(temp, arrayTemp, addr1);
-  CodeAttribs codAts(temp, "", code);
+  CodeAttribs codAts(temp, operand(), code);
   DEBUG_EXIT();
   return codAts;
 }
 
 antlrcpp::Any CodeGenVisitor::visitValue(AslParser::ValueContext *ctx) {
   DEBUG_ENTER();
-  instructionList code;
-  std::string temp = "%"+codeCounters.newTEMP();
-  if (ctx->INTVAL())
-    code = instruction::ILOAD(temp, ctx->getText());
+  operand temp = codeCounters.newTEMP();
+  operand value;
+  if (getConstantDecor(ctx).known)
+    value = immediate(ctx);
+  // a literal out of range for its type: an int wraps to 32 bits,
+  // and a float becomes the largest one (or underflows to zero)
   else if (ctx->FLOATVAL())
-    code = instruction::FLOAD(temp, ctx->getText());
-  else if (ctx->BOOLVAL() and ctx->getText()=="true")
-    code = instruction::ILOAD(temp, "1");
-  else if (ctx->BOOLVAL() and ctx->getText()=="false")
-    code = instruction::ILOAD(temp, "0");
-  else if (ctx->CHARVAL()) {
-    std::string charval = ctx->getText();
-    if (charval.length() == 3) { // chars normales. e.g. 'a'
-      code = instruction::CHLOAD(temp, charval.substr(1,1));
-    }
-    else { // chars "compuestos". e.g. '\n'
-        code = instruction::CHLOAD(temp, charval.substr(1,2));
-    }
-  }
-  CodeAttribs codAts(temp, "", code);
+    value = operand::FLOATCONST(std::fmin(std::strtof(ctx->getText().c_str(), nullptr), FLT_MAX));
+  else
+    value = operand::INTCONST(int32_t(std::strtoll(ctx->getText().c_str(), nullptr, 10)));
+  instruction::Operation load = instruction::_ILOAD;
+  if (ctx->FLOATVAL())
+    load = instruction::_FLOAD;
+  else if (ctx->CHARVAL())
+    load = instruction::_CHLOAD;
+  CodeAttribs codAts(temp, operand(), instruction(load, temp, value));
   DEBUG_EXIT();
   return codAts;
 }
@@ -674,13 +852,22 @@ antlrcpp::Any CodeGenVisitor::visitProcCallInExpr(AslParser::ProcCallInExprConte
   int i = 0;
   while (ctx->expr(i)) {
     CodeAttribs     && codAt1 = visit(ctx->expr(i));
-    std::string         addr1 = codAt1.addr;
+    operand             addr1 = codAt1.addr;
     instructionList &   code1 = codAt1.code;
-    code = code || code1;
     TypesMgr::TypeId tExpr = getTypeDecor(ctx->expr(i));
     TypesMgr::TypeId tParam = Types.getParameterType(tFunc, i);
+    if (Types.isIntegerTy(tExpr) and Types.isFloatTy(tParam) and isFoldable(ctx->expr(i))) {
+      // float immediate instead of the coercion
+      operand floatTemp = codeCounters.newTEMP();
+      code = code ||
+             loadAsFloat(floatTemp, ctx->expr(i)) ||
+             instruction::PUSH(floatTemp);
+      ++i;
+      continue;
+    }
+    code = code || code1;
     if (Types.isIntegerTy(tExpr) and Types.isFloatTy(tParam)) {
-      std::string floatTemp = "%"+codeCounters.newTEMP();
+      operand floatTemp = codeCounters.newTEMP();
       code = code ||
              instruction::FLOAT(floatTemp, addr1) ||
              instruction::PUSH(floatTemp);
@@ -688,7 +875,7 @@ antlrcpp::Any CodeGenVisitor::visitProcCallInExpr(AslParser::ProcCallInExprConte
     else {
       if (Types.isArrayTy(tExpr)) {
         // push array reference
-        std::string refTemp = "%"+codeCounters.newTEMP();
+        operand refTemp = codeCounters.newTEMP();
         code = code ||
                instruction::ALOAD(refTemp, addr1) ||
                instruction::PUSH(refTemp);
@@ -705,9 +892,9 @@ antlrcpp::Any CodeGenVisitor::visitProcCallInExpr(AslParser::ProcCallInExprConte
     code = code || instruction::POP();
     i--;
   }
-  std::string temp = "%"+codeCounters.newTEMP();
+  operand temp = codeCounters.newTEMP();
   code = code || instruction::POP(temp); // POP return
-  CodeAttribs codAts(temp, "", code);
+  CodeAttribs codAts(temp, operand(), code);
 
   DEBUG_EXIT();
   return codAts;
@@ -726,10 +913,10 @@ antlrcpp::Any CodeGenVisitor::visitReturnStmt(AslParser::ReturnStmtContext *ctx)
   instructionList code = instructionList();
   if (ctx->expr()) {
     CodeAttribs     && codAt1 = visit(ctx->expr());
-    std::string         addr1 = codAt1.addr;
+    operand             addr1 = codAt1.addr;
     instructionList &   code1 = codAt1.code;
     code = code || code1 ||
-    instruction::LOAD("_result", addr1) ||
+    instruction::LOAD(operand::NAME("_result"), addr1) ||
     instruction::RETURN();
 
   }
@@ -743,7 +930,7 @@ antlrcpp::Any CodeGenVisitor::visitReturnStmt(AslParser::ReturnStmtContext *ctx)
 
 antlrcpp::Any CodeGenVisitor::visitIdent(AslParser::IdentContext *ctx) {
   DEBUG_ENTER();
-  CodeAttribs codAts(ctx->ID()->getText(), "", instructionList());
+  CodeAttribs codAts(operand::NAME(ctx->ID()->getText()), operand(), instructionList());
   DEBUG_EXIT();
   return codAts;
 }
@@ -757,18 +944,196 @@ SymTable::ScopeId CodeGenVisitor::getScopeDecor(antlr4::ParserRuleContext *ctx)
 TypesMgr::TypeId CodeGenVisitor::getTypeDecor(antlr4::ParserRuleContext *ctx) const {
   return Decorations.getType(ctx);
 }
+ConstValue CodeGenVisitor::getConstantDecor(antlr4::ParserRuleContext *ctx) const {
+  return Decorations.getConstant(ctx);
+}
+
+
+// Constant folding:
+//   tvm has no negative immediates, so negative values are loaded
+//   negated and then negated again (INT_MIN, infinities and NaN can
+//   not be loaded this way, and keep their code)
+bool CodeGenVisitor::isFoldable(antlr4::ParserRuleContext *ctx) const {
+  if (not FoldConstants) return false;
+  ConstValue v = getConstantDecor(ctx);
+  if (not v.known) return false;
+  TypesMgr::TypeId t = getTypeDecor(ctx);
+  if (Types.isFloatTy(t))
+    return std::isfinite(v.fval);
+  return v.ival != INT_MIN;
+}
+
+instructionList CodeGenVisitor::loadConstant(const operand & temp, const ConstValue & v,
+                                             TypesMgr::TypeId t) const {
+  if (Types.isFloatTy(t)) {
+    if (std::signbit(v.fval))
+      return instruction::FLOAD(temp, -v.fval) || instruction::FNEG(temp, temp);
+    return instruction::FLOAD(temp, v.fval);
+  }
+  if (Types.isCharacterTy(t))
+    return instruction::CHLOAD(temp, char(v.ival));
+  if (v.ival < 0)
+    return instruction::ILOAD(temp, -v.ival) || instruction::NEG(temp, temp);
+  return instruction::ILOAD(temp, v.ival);
+}
+
+instructionList CodeGenVisitor::loadAsFloat(const operand & temp,
+                                            antlr4::ParserRuleContext *ctx) const {
+  ConstValue v = getConstantDecor(ctx);
+  v.fval = float(v.ival);
+  return loadConstant(temp, v, Types.createFloatTy());
+}
+
+antlrcpp::Any CodeGenVisitor::visitFoldedExpr(antlr4::ParserRuleContext *ctx) {
+  DEBUG_ENTER();
+  operand temp = codeCounters.newTEMP();
+  CodeAttribs codAts(temp, operand(), loadConstant(temp, getConstantDecor(ctx), getTypeDecor(ctx)));
+  DEBUG_EXIT();
+  return codAts;
+}
+
+
+// Immediate operands:
+//   a literal is always known (the type check decorates it), other
+//   expressions only when folding constants. As in isFoldable, values
+//   that are not finite keep their code
+bool CodeGenVisitor::isImmediate(antlr4::ParserRuleContext *ctx) const {
+  if (not Immediates) return false;
+  ConstValue v = getConstantDecor(ctx);
+  if (not v.known) return false;
+  if (Types.isFloatTy(getTypeDecor(ctx)) and not std::isfinite(v.fval)) return false;
+  if (FoldConstants) return true;
+  while (auto paren = dynamic_cast<AslParser::ParenthesisExprContext *>(ctx))
+    ctx = paren->expr();
+  return dynamic_cast<AslParser::ValueContext *>(ctx) != nullptr;
+}
+
+operand CodeGenVisitor::immediate(antlr4::ParserRuleContext *ctx, bool asFloat) const {
+  ConstValue v = getConstantDecor(ctx);
+  TypesMgr::TypeId t = getTypeDecor(ctx);
+  if (Types.isFloatTy(t))
+    return operand::FLOATCONST(v.fval);
+  if (asFloat and Types.isIntegerTy(t))
+    return operand::FLOATCONST(float(v.ival));
+  if (Types.isCharacterTy(t))
+    return operand::CHARCONST(char(v.ival));
+  return operand::INTCONST(v.ival);
+}
+
+antlrcpp::Any CodeGenVisitor::visitOperand(AslParser::ExprContext *ctx, bool asFloat) {
+  if (not isImmediate(ctx)) return visit(ctx);
+  CodeAttribs codAts(immediate(ctx, asFloat), operand(), instructionList());
+  return codAts;
+}
+
+
+// Short-circuit evaluation:
+//   'a and b' jumps when false if 'a' or 'b' is false, and when true
+//   if 'a' is true and then 'b' is true ('or' is the other way round).
+//   tvm only jumps on false, so other conditions jump on true with a
+//   NOT before the FJUMP
+instructionList CodeGenVisitor::codeCondition(AslParser::ExprContext *ctx,
+                                              const std::string & label, bool jumpIf) {
+  if (isFoldable(ctx)) {
+    if (bool(getConstantDecor(ctx).ival) == jumpIf)
+      return instruction::UJUMP(label);
+    return instructionList();
+  }
+  if (auto paren = dynamic_cast<AslParser::ParenthesisExprContext *>(ctx))
+    return codeCondition(paren->expr(), label, jumpIf);
+  if (auto unary = dynamic_cast<AslParser::BooleanUnaryContext *>(ctx))
+    return codeCondition(unary->expr(), label, not jumpIf);
+  if (auto binary = dynamic_cast<AslParser::BooleanBinaryContext *>(ctx)) {
+    // the value of 'a' that decides the result: false for and, true for or
+    bool decides = bool(binary->OR());
+    if (decides == jumpIf)
+      return codeCondition(binary->expr(0), label, jumpIf) ||
+             codeCondition(binary->expr(1), label, jumpIf);
+    std::string labelSkip = "cond"+codeCounters.newLabelCOND();
+    return codeCondition(binary->expr(0), labelSkip, decides) ||
+           codeCondition(binary->expr(1), label, jumpIf) ||
+           instruction::LABEL(labelSkip);
+  }
+  if (auto rel = comparison(ctx))
+    return codeCompareJump(rel, label, jumpIf);
+  CodeAttribs     && codAts = visit(ctx);
+  operand             addr1 = codAts.addr;
+  instructionList &    code = codAts.code;
+  if (jumpIf) {
+    operand temp = codeCounters.newTEMP();
+    return code || instruction::NOT(temp, addr1) || instruction::FJUMP(temp, label);
+  }
+  return code || instruction::FJUMP(addr1, label);
+}
+
+
+// Compare-and-branch:
+//   the operands are those of visitRelational. 'a > b' is 'b < a' and
+//   'a >= b' is 'b <= a', and each comparison has an instruction that
+//   jumps when it holds and one that jumps when it does not
+AslParser::RelationalContext * CodeGenVisitor::comparison(AslParser::ExprContext *ctx) const {
+  if (not CompareJumps or isFoldable(ctx)) return nullptr;
+  while (auto paren = dynamic_cast<AslParser::ParenthesisExprContext *>(ctx))
+    ctx = paren->expr();
+  return dynamic_cast<AslParser::RelationalContext *>(ctx);
+}
+
+instructionList CodeGenVisitor::codeCompareJump(AslParser::RelationalContext *ctx,
+                                                const std::string & label, bool jumpIf) {
+  TypesMgr::TypeId t1 = getTypeDecor(ctx->expr(0));
+  TypesMgr::TypeId t2 = getTypeDecor(ctx->expr(1));
+  bool floats = not (Types.isIntegerTy(t1) and Types.isIntegerTy(t2));
+  CodeAttribs     && codAt1 = visitOperand(ctx->expr(0), floats);
+  operand             addr1 = codAt1.addr;
+  instructionList &   code1 = codAt1.code;
+  CodeAttribs     && codAt2 = visitOperand(ctx->expr(1), floats);
+  operand             addr2 = codAt2.addr;
+  instructionList &   code2 = codAt2.code;
+  instructionList &&   code = code1 || code2;
+  if (floats and Types.isIntegerTy(t1) and not addr1.is_const()) {
+    operand temp1 = codeCounters.newTEMP();
+    if (isFoldable(ctx->expr(0)))
+      code = loadAsFloat(temp1, ctx->expr(0)) || code2;
+    else
+      code = code || instruction::FLOAT(temp1, addr1);
+    addr1 = temp1;
+  }
+  else if (floats and Types.isIntegerTy(t2) and not addr2.is_const()) {
+    operand temp2 = codeCounters.newTEMP();
+    if (isFoldable(ctx->expr(1)))
+      code = code1 || loadAsFloat(temp2, ctx->expr(1));
+    else
+      code = code || instruction::FLOAT(temp2, addr2);
+    addr2 = temp2;
+  }
+  if (ctx->G() or ctx->GEQ())
+    std::swap(addr1, addr2);
+  // jump when the comparison holds (when it does not, for '!=')
+  bool holds = (jumpIf != bool(ctx->NEQUAL()));
+  instruction::Operation oper;
+  if (ctx->EQUAL() or ctx->NEQUAL())
+    oper = floats ? (holds ? instruction::_IFFEQ : instruction::_IFFNEQ) :
+                    (holds ? instruction::_IFEQ : instruction::_IFNEQ);
+  else if (ctx->L() or ctx->G())
+    oper = floats ? (holds ? instruction::_IFFLT : instruction::_IFFNLT) :
+                    (holds ? instruction::_IFLT : instruction::_IFNLT);
+  else
+    oper = floats ? (holds ? instruction::_IFFLE : instruction::_IFFNLE) :
+                    (holds ? instruction::_IFLE : instruction::_IFNLE);
+  return code || instruction(oper, addr1, addr2, operand::LABEL(label));
+}
 
 
 // Constructors of the class CodeAttribs:
 //
-CodeGenVisitor::CodeAttribs::CodeAttribs(const std::string & addr,
-					 const std::string & offs,
+CodeGenVisitor::CodeAttribs::CodeAttribs(const operand & addr,
+					 const operand & offs,
 					 instructionList & code) :
   addr{addr}, offs{offs}, code{code} {
 }
 
-CodeGenVisitor::CodeAttribs::CodeAttribs(const std::string & addr,
-					 const std::string & offs,
+CodeGenVisitor::CodeAttribs::CodeAttribs(const operand & addr,
+					 const operand & offs,
 					 instructionList && code) :
   addr{addr}, offs{offs}, code{code} {
 }
@@ -57,10 +57,27 @@ class CodeGenVisitor final : public AslBaseVisitor {
 
 public:
 
-  // Constructor
+  // Constructor (FoldConstants: use the constant decoration to replace
+  // expressions with known values by immediates, and drop dead branches;
+  // ShortCircuit: in the conditions of if and while, the second operand
+  // of and/or is only evaluated when the first does not decide;
+  // BlockCopy: the VM has ACOPY, used to assign whole arrays;
+  // StringPool: the VM has WRITES, used to write string literals
+  // kept in the string constants of the program;
+  // Immediates: the VM takes constants as operands of arithmetic,
+  // relational and indexing instructions, so literals (and with
+  // FoldConstants, all known values) are used without loading them;
+  // CompareJumps: the VM has compare-and-branch instructions (IFLT...),
+  // used when the condition of an if or while is a comparison)
   CodeGenVisitor(TypesMgr       & Types,
 		 SymTable       & Symbols,
-		 TreeDecoration & Decorations);
+		 TreeDecoration & Decorations,
+		 bool             FoldConstants = false,
+		 bool             ShortCircuit = false,
+		 bool             BlockCopy = false,
+		 bool             StringPool = false,
+		 bool             Immediates = false,
+		 bool             CompareJumps = false);
 
   // Methods to visit each kind of node:
   antlrcpp::Any visitProgram(AslParser::ProgramContext *ctx);
@@ -102,11 +119,49 @@ private:
   SymTable        & Symbols;
   TreeDecoration  & Decorations;
   counters          codeCounters;
+  bool              FoldConstants;
+  bool              ShortCircuit;
+  bool              BlockCopy;
+  bool              StringPool;
+  bool              Immediates;
+  bool              CompareJumps;
+  // program being generated (to add string constants)
+  code            * Program;
 
   // Getters for the necessary tree node atributes:
-  //   Scope and Type
-  SymTable::ScopeId getScopeDecor (antlr4::ParserRuleContext *ctx) const;
-  TypesMgr::TypeId  getTypeDecor  (antlr4::ParserRuleContext *ctx) const;
+  //   Scope, Type and Constant
+  SymTable::ScopeId getScopeDecor    (antlr4::ParserRuleContext *ctx) const;
+  TypesMgr::TypeId  getTypeDecor     (antlr4::ParserRuleContext *ctx) const;
+  ConstValue        getConstantDecor (antlr4::ParserRuleContext *ctx) const;
+
+  // Constant folding: whether the value of an expression is used instead
+  // of its code (it is known and tvm can load it with immediates), and
+  // the code that loads the value in 'temp' (loadAsFloat folds the
+  // int -> float coercion of an integer expression)
+  bool            isFoldable     (antlr4::ParserRuleContext *ctx) const;
+  instructionList loadConstant   (const operand & temp, const ConstValue & v,
+				  TypesMgr::TypeId t) const;
+  instructionList loadAsFloat    (const operand & temp, antlr4::ParserRuleContext *ctx) const;
+  antlrcpp::Any   visitFoldedExpr(antlr4::ParserRuleContext *ctx);
+
+  // Immediate operands: whether an expression is used as a constant
+  // operand, the operand for it (asFloat folds the int -> float
+  // coercion), and the code attributes of an operand that may be one
+  bool            isImmediate    (antlr4::ParserRuleContext *ctx) const;
+  operand         immediate      (antlr4::ParserRuleContext *ctx, bool asFloat = false) const;
+  antlrcpp::Any   visitOperand   (AslParser::ExprContext *ctx, bool asFloat = false);
+
+  // Short-circuit evaluation: code for a condition that jumps to 'label'
+  // when its value is 'jumpIf', and falls through otherwise
+  instructionList codeCondition  (AslParser::ExprContext *ctx,
+				  const std::string & label, bool jumpIf);
+
+  // Compare-and-branch: the comparison a condition is (in parentheses
+  // or not; nullptr if it is not one), and the code that compares and
+  // jumps to 'label' when the comparison is 'jumpIf'
+  AslParser::RelationalContext * comparison(AslParser::ExprContext *ctx) const;
+  instructionList codeCompareJump(AslParser::RelationalContext *ctx,
+				  const std::string & label, bool jumpIf);
 
 
   //////////////////////////////////////////////////////////////////
@@ -120,18 +175,18 @@ private:
 
   public:
     // Constructors
-    CodeAttribs(const std::string & addr,
-	        const std::string & offs,
+    CodeAttribs(const operand & addr,
+	        const operand & offs,
 		instructionList & code);
-    CodeAttribs(const std::string & addr,
-	        const std::string & offs,
+    CodeAttribs(const operand & addr,
+	        const operand & offs,
 		instructionList && code);
 
     // Attributes (publics):
     //   - the address that will hold the value of an expression
-    std::string addr;
+    operand addr;
     //   - the offset applied to the address (for array access)
-    std::string offs;
+    operand offs;
     //   - the three-address code associated to an statement/expression
     instructionList code;
 
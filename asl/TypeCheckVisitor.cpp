@@ -39,6 +39,11 @@
 
 #include <iostream>
 #include <string>
+#include <cstdint>
+#include <climits>    // INT_MIN
+#include <cstdlib>    // std::strtoll, std::strtof
+#include <cerrno>
+#include <cmath>      // std::isfinite
 
 // uncomment the following line to enable debugging messages with DEBUG*
 // #define DEBUG_BUILD
@@ -296,6 +301,34 @@ antlrcpp::Any TypeCheckVisitor::visitArithmeticBinary(AslParser::ArithmeticBinar
 	}
   putTypeDecor(ctx, t);
   putIsLValueDecor(ctx, false);
+
+  // constant folding (integers wrap around as in tvm, and a division
+  // that would trap at run time is left to the run time)
+  ConstValue c1 = getConstantDecor(ctx->expr(0));
+  ConstValue c2 = getConstantDecor(ctx->expr(1));
+  if (c1.known and c2.known and Types.isNumericTy(t1) and Types.isNumericTy(t2)) {
+    ConstValue c;
+    if (Types.isIntegerTy(t1) and Types.isIntegerTy(t2)) {
+      uint32_t a = c1.ival, b = c2.ival;
+      bool trap = (c2.ival == 0) or (c1.ival == INT_MIN and c2.ival == -1);
+      c.known = true;
+      if (ctx->MUL())       c.ival = int32_t(a * b);
+      else if (ctx->PLUS()) c.ival = int32_t(a + b);
+      else if (ctx->SUB())  c.ival = int32_t(a - b);
+      else if (trap)        c.known = false;
+      else if (ctx->DIV())  c.ival = c1.ival / c2.ival;
+      else                  c.ival = c1.ival % c2.ival;
+    }
+    else if (not ctx->MOD()) {
+      float a = getFloatValue(c1, t1), b = getFloatValue(c2, t2);
+      c.known = true;
+      if (ctx->MUL())       c.fval = a * b;
+      else if (ctx->DIV())  c.fval = a / b;
+      else if (ctx->PLUS()) c.fval = a + b;
+      else if (ctx->SUB())  c.fval = a - b;
+    }
+    putConstantDecor(ctx, c);
+  }
   DEBUG_EXIT();
   return 0;
 }
@@ -314,6 +347,32 @@ antlrcpp::Any TypeCheckVisitor::visitRelational(AslParser::RelationalContext *ct
   TypesMgr::TypeId t = Types.createBooleanTy();
   putTypeDecor(ctx, t);
   putIsLValueDecor(ctx, false);
+
+  // constant folding (mixed int/float operands are compared as floats)
+  ConstValue c1 = getConstantDecor(ctx->expr(0));
+  ConstValue c2 = getConstantDecor(ctx->expr(1));
+  if (c1.known and c2.known and (not Types.isErrorTy(t1)) and (not Types.isErrorTy(t2)) and
+      Types.comparableTypes(t1, t2, oper)) {
+    bool eq, lt;
+    if (Types.isFloatTy(t1) or Types.isFloatTy(t2)) {
+      float a = getFloatValue(c1, t1), b = getFloatValue(c2, t2);
+      eq = (a == b);
+      lt = (a < b);
+    }
+    else {
+      eq = (c1.ival == c2.ival);
+      lt = (c1.ival < c2.ival);
+    }
+    ConstValue c;
+    c.known = true;
+    if (ctx->EQUAL())       c.ival = eq;
+    else if (ctx->NEQUAL()) c.ival = not eq;
+    else if (ctx->L())      c.ival = lt;
+    else if (ctx->LEQ())    c.ival = lt or eq;
+    else if (ctx->G())      c.ival = not (lt or eq);
+    else if (ctx->GEQ())    c.ival = not lt;
+    putConstantDecor(ctx, c);
+  }
   DEBUG_EXIT();
   return 0;
 }
@@ -321,20 +380,40 @@ antlrcpp::Any TypeCheckVisitor::visitRelational(AslParser::RelationalContext *ct
 antlrcpp::Any TypeCheckVisitor::visitValue(AslParser::ValueContext *ctx) {
   DEBUG_ENTER();
   TypesMgr::TypeId t;
+  ConstValue c;
+  c.known = true;
 	if (ctx->INTVAL()) {
 		t = Types.createIntegerTy();
   	putTypeDecor(ctx, t);
+		// a literal out of range is not known (and so not folded)
+		errno = 0;
+		long long v = std::strtoll(ctx->getText().c_str(), nullptr, 10);
+		c.known = (errno == 0 and v <= INT32_MAX);
+		c.ival = int32_t(v);
 	} else if (ctx->FLOATVAL()) {
 		t = Types.createFloatTy();
   	putTypeDecor(ctx, t);
+		errno = 0;
+		c.fval = std::strtof(ctx->getText().c_str(), nullptr);
+		c.known = (errno == 0 and std::isfinite(c.fval));
 	} else if (ctx->CHARVAL()) {
 		t = Types.createCharacterTy();
   	putTypeDecor(ctx, t);
+		std::string charval = ctx->getText();
+		char ch = charval[1];
+		if (charval.length() > 3) { // chars "compuestos". e.g. '\n'
+			ch = charval[2];
+			if (ch == 'n') ch = '\n';
+			else if (ch == 't') ch = '\t';
+		}
+		c.ival = ch;
 	} else if (ctx->BOOLVAL()) {
 		t = Types.createBooleanTy();
   	putTypeDecor(ctx, t);
+		c.ival = (ctx->getText() == "true");
 	}
   putIsLValueDecor(ctx, false);
+  putConstantDecor(ctx, c);
   DEBUG_EXIT();
   return 0;
 }
@@ -438,6 +517,7 @@ antlrcpp::Any TypeCheckVisitor::visitParenthesisExpr(AslParser::ParenthesisExprC
 	TypesMgr::TypeId t = getTypeDecor(ctx->expr());
   putTypeDecor(ctx, t);
   putIsLValueDecor(ctx, false);
+  putConstantDecor(ctx, getConstantDecor(ctx->expr()));
 	DEBUG_EXIT();
 	return 0;
 }
@@ -457,6 +537,14 @@ antlrcpp::Any TypeCheckVisitor::visitArithmeticUnary(AslParser::ArithmeticUnaryC
 		putTypeDecor(ctx, t);
 
 	putIsLValueDecor(ctx, false);
+	ConstValue c = getConstantDecor(ctx->expr());
+	if (c.known and Types.isNumericTy(t1)) {
+		if (ctx->SUB() and Types.isFloatTy(t1))
+			c.fval = -c.fval;
+		else if (ctx->SUB())
+			c.ival = int32_t(0u - uint32_t(c.ival));
+		putConstantDecor(ctx, c);
+	}
 	DEBUG_EXIT();
 	return 0;
 }
@@ -471,6 +559,11 @@ antlrcpp::Any TypeCheckVisitor::visitBooleanUnary(AslParser::BooleanUnaryContext
 	TypesMgr::TypeId t = Types.createBooleanTy();
 	putTypeDecor(ctx, t);
 	putIsLValueDecor(ctx, false);
+	ConstValue c = getConstantDecor(ctx->expr());
+	if (c.known and Types.isBooleanTy(t1)) {
+		c.ival = not c.ival;
+		putConstantDecor(ctx, c);
+	}
 	DEBUG_EXIT();
 	return 0;
 }
@@ -488,6 +581,15 @@ antlrcpp::Any TypeCheckVisitor::visitBooleanBinary(AslParser::BooleanBinaryConte
   TypesMgr::TypeId t = Types.createBooleanTy();
   putTypeDecor(ctx, t);
   putIsLValueDecor(ctx, false);
+  ConstValue c1 = getConstantDecor(ctx->expr(0));
+  ConstValue c2 = getConstantDecor(ctx->expr(1));
+  if (c1.known and c2.known and Types.isBooleanTy(t1) and Types.isBooleanTy(t2)) {
+    ConstValue c;
+    c.known = true;
+    if (ctx->AND()) c.ival = c1.ival and c2.ival;
+    else            c.ival = c1.ival or c2.ival;
+    putConstantDecor(ctx, c);
+  }
   DEBUG_EXIT();
   return 0;
 }
@@ -518,7 +620,7 @@ antlrcpp::Any TypeCheckVisitor::visitArray_element(AslParser::Array_elementConte
 
 
 // Getters for the necessary tree node atributes:
-//   Scope, Type ans IsLValue
+//   Scope, Type, IsLValue and Constant
 SymTable::ScopeId TypeCheckVisitor::getScopeDecor(antlr4::ParserRuleContext *ctx) {
   return Decorations.getScope(ctx);
 }
@@ -528,9 +630,12 @@ TypesMgr::TypeId TypeCheckVisitor::getTypeDecor(antlr4::ParserRuleContext *ctx)
 bool TypeCheckVisitor::getIsLValueDecor(antlr4::ParserRuleContext *ctx) {
   return Decorations.getIsLValue(ctx);
 }
+ConstValue TypeCheckVisitor::getConstantDecor(antlr4::ParserRuleContext *ctx) {
+  return Decorations.getConstant(ctx);
+}
 
 // Setters for the necessary tree node attributes:
-//   Scope, Type ans IsLValue
+//   Scope, Type, IsLValue and Constant
 void TypeCheckVisitor::putScopeDecor(antlr4::ParserRuleContext *ctx, SymTable::ScopeId s) {
   Decorations.putScope(ctx, s);
 }
@@ -540,3 +645,11 @@ void TypeCheckVisitor::putTypeDecor(antlr4::ParserRuleContext *ctx, TypesMgr::Ty
 void TypeCheckVisitor::putIsLValueDecor(antlr4::ParserRuleContext *ctx, bool b) {
   Decorations.putIsLValue(ctx, b);
 }
+void TypeCheckVisitor::putConstantDecor(antlr4::ParserRuleContext *ctx, const ConstValue & v) {
+  Decorations.putConstant(ctx, v);
+}
+
+// Value of a known constant of type t as a float (int -> float coercion)
+float TypeCheckVisitor::getFloatValue(const ConstValue & v, TypesMgr::TypeId t) {
+  return Types.isFloatTy(t) ? v.fval : float(v.ival);
+}
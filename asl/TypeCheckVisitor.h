@@ -103,15 +103,20 @@ private:
   SemErrors      & Errors;
 
   // Getters for the necessary tree node atributes:
-  //   Scope, Type ans IsLValue
+  //   Scope, Type, IsLValue and Constant
   SymTable::ScopeId getScopeDecor    (antlr4::ParserRuleContext *ctx);
   TypesMgr::TypeId  getTypeDecor     (antlr4::ParserRuleContext *ctx);
   bool              getIsLValueDecor (antlr4::ParserRuleContext *ctx);
+  ConstValue        getConstantDecor (antlr4::ParserRuleContext *ctx);
 
   // Setters for the necessary tree node attributes:
-  //   Scope, Type ans IsLValue
+  //   Scope, Type, IsLValue and Constant
   void putScopeDecor    (antlr4::ParserRuleContext *ctx, SymTable::ScopeId s);
   void putTypeDecor     (antlr4::ParserRuleContext *ctx, TypesMgr::TypeId t);
   void putIsLValueDecor (antlr4::ParserRuleContext *ctx, bool b);
+  void putConstantDecor (antlr4::ParserRuleContext *ctx, const ConstValue & v);
+
+  // Value of a known constant of type t as a float (int -> float coercion)
+  float getFloatValue (const ConstValue & v, TypesMgr::TypeId t);
 
 };  // class TypeCheckVisitor
@@ -60,3 +60,37 @@ echo "END   examples-initial/execution"
 #     rm -f tmp.t tmp.out
 # done
 # echo "END   examples-full/execution"
+
+# The optimizer must not change what a program does: the output of
+# each jpopt/jpbasic example, compiled with -O, is compared with the
+# output of the plain code (.out).
+
+echo ""
+echo "BEGIN examples-opt/execution"
+for f in ../examples/jpopt_genc_*.asl ../examples/jpbasic_genc_*.asl; do
+    echo $(basename "$f")
+    ./asl -O "$f" > tmp.t
+    ../tvm/tvm tmp.t < "${f/asl/in}" > tmp.out
+    diff tmp.out "${f/asl/out}"
+    rm -f tmp.t tmp.out
+done
+echo "END   examples-opt/execution"
+
+# The same holds for the code generation options. tvm does not run
+# some of the code they emit, so it goes through tvmi, built with
+# 'make -C ../interp'.
+
+echo ""
+echo "BEGIN examples-opt/options"
+for f in ../examples/jpopt_genc_*.asl ../examples/jpbasic_genc_*.asl; do
+    for opts in "-O" "--short-circuit" "-O --short-circuit" "--acopy" \
+                "--writes" "--immediates" "--compare-jumps" \
+                "-O --short-circuit --acopy --writes --immediates --compare-jumps"; do
+        echo $(basename "$f") $opts
+        ./asl $opts "$f" > tmp.t
+        ../interp/tvmi tmp.t < "${f/asl/in}" > tmp.out
+        diff tmp.out "${f/asl/out}"
+        rm -f tmp.t tmp.out
+    done
+done
+echo "END   examples-opt/options"
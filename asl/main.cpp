@@ -41,10 +41,14 @@
 #include "SymbolsVisitor.h"
 #include "TypeCheckVisitor.h"
 #include "../common/code.h"
+#include "../common/tbc.h"
+#include "../common/Optimizer.h"
 #include "CodeGenVisitor.h"
 
 #include <iostream>
 #include <fstream>    // ifstream
+#include <string>
+#include <vector>
 
 #include <cstdio>     // fopen
 #include <cstdlib>    // EXIT_FAILURE, EXIT_SUCCESS
@@ -54,21 +58,67 @@
 
 
 int main(int argc, const char* argv[]) {
+  // all I/O goes through C++ streams
+  std::ios::sync_with_stdio(false);
+
   // check the correct use of the program
-  if (argc > 2) {
-    std::cout << "Usage: ./main [<file>]" << std::endl;
-    return EXIT_FAILURE;
+  //   --emit=t    output textual t-code (default)
+  //   --emit=tbc  output binary t-code (see common/tbc.h)
+  //   -o <file>   write output to <file> instead of std::cout
+  //   -O          optimize the generated code (see common/Optimizer.h)
+  //   --short-circuit  evaluate the second operand of and/or in if and
+  //               while conditions only when the first does not decide
+  //   --acopy     assign whole arrays with ACOPY (the VM must have it)
+  //   --writes    write string literals with WRITES (the VM must have it)
+  //   --immediates use constants as operands of arithmetic, relational and
+  //                indexing instructions (the VM must have them)
+  //   --compare-jumps  compare and branch in one instruction in if and
+  //               while conditions (the VM must have IFLT and the like)
+  std::string emit = "t";
+  bool optimize = false;
+  bool shortCircuit = false;
+  bool blockCopy = false;
+  bool stringPool = false;
+  bool immediates = false;
+  bool compareJumps = false;
+  const char *fname = nullptr;
+  const char *oname = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 7, "--emit=") == 0 and
+        (arg.substr(7) == "t" or arg.substr(7) == "tbc"))
+      emit = arg.substr(7);
+    else if (arg == "-O")
+      optimize = true;
+    else if (arg == "--short-circuit")
+      shortCircuit = true;
+    else if (arg == "--acopy")
+      blockCopy = true;
+    else if (arg == "--writes")
+      stringPool = true;
+    else if (arg == "--immediates")
+      immediates = true;
+    else if (arg == "--compare-jumps")
+      compareJumps = true;
+    else if (arg == "-o" and i+1 < argc and not oname)
+      oname = argv[++i];
+    else if (not fname and arg[0] != '-')
+      fname = argv[i];
+    else {
+      std::cout << "Usage: ./main [-O] [--short-circuit] [--acopy] [--writes] [--immediates] [--compare-jumps] [--emit=t|tbc] [-o <outfile>] [<file>]" << std::endl;
+      return EXIT_FAILURE;
+    }
   }
-  if (argc == 2 and not std::fopen(argv[1], "r")) {
-    std::cout << "No such file: " << argv[1] << std::endl;
+  if (fname and not std::fopen(fname, "r")) {
+    std::cout << "No such file: " << fname << std::endl;
     return EXIT_FAILURE;
   }
 
   // open input file (or std::cin) and create a character stream
   antlr4::ANTLRInputStream input;
-  if (argc == 2) {  // read from <file>
+  if (fname) {      // read from <file>
     std::ifstream stream;
-    stream.open(argv[1]);
+    stream.open(fname);
     input = antlr4::ANTLRInputStream(stream);
   }
   else {            // read fron std::cin
@@ -123,11 +173,38 @@ int main(int argc, const char* argv[]) {
 
   // create a third visitor that will return the generated code
   // for each part of the tree, and will store it in 'mycode'
-  CodeGenVisitor codegenerator(types, symbols, decorations);
+  CodeGenVisitor codegenerator(types, symbols, decorations, optimize,
+                               shortCircuit, blockCopy, stringPool, immediates,
+                               compareJumps);
   code mycode = codegenerator.visit(tree);
 
-  // print generated code as output
-  std::cout << mycode.dump() << std::endl;
+  if (optimize) optimizer::run(mycode);
+
+  // print generated code as output, streaming it through a large
+  // buffer to <outfile> or std::cout
+  std::vector<char> outbuf(1 << 20);
+  std::ofstream outfile;
+  std::ostream *out = &std::cout;
+  if (oname) {
+    outfile.rdbuf()->pubsetbuf(outbuf.data(), outbuf.size());
+    outfile.open(oname, std::ios::out | std::ios::binary);
+    if (not outfile) {
+      std::cout << "Can not write file: " << oname << std::endl;
+      return EXIT_FAILURE;
+    }
+    out = &outfile;
+  }
+  if (emit == "tbc")
+    tbcWriter::write(mycode, *out);
+  else {
+    mycode.dump(*out);
+    *out << '\n';
+  }
+  out->flush();
+  if (not *out) {
+    std::cout << "Error writing output" << std::endl;
+    return EXIT_FAILURE;
+  }
 
   return EXIT_SUCCESS;
 }
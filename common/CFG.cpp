@@ -0,0 +1,275 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CFG - Basic blocks and control flow graph of a subroutine
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#include "CFG.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'basicBlock'
+
+basicBlock::basicBlock(size_t f, size_t l) : first(f), last(l), idom(CFG::NONE) {}
+size_t basicBlock::size() const { return last - first; }
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'loop'
+
+bool loop::contains(size_t b) const { return binary_search(blocks.begin(), blocks.end(), b); }
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'CFG'
+
+const size_t CFG::NONE = size_t(-1);
+
+/// build the graph for given subroutine
+CFG::CFG(const subroutine &s) : sub(s) {
+  build_blocks();
+  build_rpo();
+  build_dominators();
+  build_loops();
+}
+
+/// split instructions in blocks and link them
+void CFG::build_blocks() {
+  const vector<instruction> &ins = sub.get_instructions();
+  size_t n = ins.size();
+  blockOf.assign(n, NONE);
+
+  size_t first = 0;
+  for (size_t pc = 0; pc < n; ++pc) {
+    const instruction &i = ins[pc];
+    // a label starts a new block, a jump or return ends the current one
+    if (i.oper == instruction::_LABEL and pc > first) {
+      blocks.push_back(basicBlock(first, pc));
+      first = pc;
+    }
+    blockOf[pc] = blocks.size();
+    if (i.is_jump() or i.oper == instruction::_RETURN) {
+      blocks.push_back(basicBlock(first, pc+1));
+      first = pc+1;
+    }
+  }
+  if (first < n) blocks.push_back(basicBlock(first, n));
+
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    const instruction &i = ins[blocks[b].last-1];
+    if (i.oper == instruction::_RETURN) continue;
+    if (i.oper != instruction::_UJUMP and b+1 < blocks.size()) add_edge(b, b+1);
+    if (i.is_jump() and get_jump_target(b) != NONE) add_edge(b, get_jump_target(b));
+  }
+}
+
+/// add edge (ignoring duplicates, e.g. a FJUMP to the next block)
+void CFG::add_edge(size_t from, size_t to) {
+  vector<size_t> &s = blocks[from].succs;
+  if (find(s.begin(), s.end(), to) != s.end()) return;
+  s.push_back(to);
+  blocks[to].preds.push_back(from);
+}
+
+/// order reachable blocks in reverse postorder
+void CFG::build_rpo() {
+  size_t nb = blocks.size();
+  rpo.clear();
+  rpoIndex.assign(nb, NONE);
+  if (nb == 0) return;
+
+  vector<bool> visited(nb, false);
+  vector<pair<size_t, size_t>> stack;   // (block, next successor to visit)
+  stack.push_back(make_pair(0, 0));
+  visited[0] = true;
+  while (not stack.empty()) {
+    size_t b = stack.back().first;
+    size_t &k = stack.back().second;
+    if (k < blocks[b].succs.size()) {
+      size_t s = blocks[b].succs[k++];
+      if (not visited[s]) {
+        visited[s] = true;
+        stack.push_back(make_pair(s, 0));
+      }
+    }
+    else {
+      rpo.push_back(b);
+      stack.pop_back();
+    }
+  }
+  reverse(rpo.begin(), rpo.end());
+  for (size_t k = 0; k < rpo.size(); ++k) rpoIndex[rpo[k]] = k;
+}
+
+/// compute immediate dominators (Cooper, Harvey & Kennedy) and number
+/// the dominator tree so that 'dominates' is constant time
+void CFG::build_dominators() {
+  size_t nb = blocks.size();
+  domPre.assign(nb, NONE);
+  domPost.assign(nb, NONE);
+  if (nb == 0) return;
+
+  vector<size_t> idom(nb, NONE);
+  idom[0] = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t k = 1; k < rpo.size(); ++k) {
+      size_t b = rpo[k];
+      size_t d = NONE;
+      for (size_t p : blocks[b].preds) {
+        if (idom[p] == NONE) continue;
+        if (d == NONE) { d = p; continue; }
+        // intersect both paths up the tree
+        size_t x = p;
+        while (x != d) {
+          while (rpoIndex[x] > rpoIndex[d]) x = idom[x];
+          while (rpoIndex[d] > rpoIndex[x]) d = idom[d];
+        }
+      }
+      if (idom[b] != d) {
+        idom[b] = d;
+        changed = true;
+      }
+    }
+  }
+
+  for (size_t k = 1; k < rpo.size(); ++k) {
+    size_t b = rpo[k];
+    blocks[b].idom = idom[b];
+    blocks[idom[b]].dom_children.push_back(b);
+  }
+
+  size_t count = 0;
+  vector<pair<size_t, size_t>> stack;
+  stack.push_back(make_pair(0, 0));
+  domPre[0] = count++;
+  while (not stack.empty()) {
+    size_t b = stack.back().first;
+    size_t &k = stack.back().second;
+    if (k < blocks[b].dom_children.size()) {
+      size_t c = blocks[b].dom_children[k++];
+      domPre[c] = count++;
+      stack.push_back(make_pair(c, 0));
+    }
+    else {
+      domPost[b] = count++;
+      stack.pop_back();
+    }
+  }
+}
+
+/// find natural loops and their nesting
+void CFG::build_loops() {
+  size_t nb = blocks.size();
+  loops.clear();
+  loopOf.assign(nb, NONE);
+
+  vector<size_t> mark(nb, NONE);
+  vector<size_t> work;
+  // headers in reverse postorder: enclosing loops come first
+  for (size_t h : rpo) {
+    loop l;
+    l.header = h;
+    for (size_t p : blocks[h].preds)
+      if (dominates(h, p)) l.latches.push_back(p);
+    if (l.latches.empty()) continue;
+
+    size_t id = loops.size();
+    mark[h] = id;
+    l.blocks.push_back(h);
+    work = l.latches;
+    while (not work.empty()) {
+      size_t b = work.back();
+      work.pop_back();
+      if (mark[b] == id or not is_reachable(b)) continue;
+      mark[b] = id;
+      l.blocks.push_back(b);
+      for (size_t p : blocks[b].preds) work.push_back(p);
+    }
+    sort(l.blocks.begin(), l.blocks.end());
+
+    l.parent = loopOf[h];
+    l.depth = (l.parent == NONE ? 1 : loops[l.parent].depth + 1);
+    for (size_t b : l.blocks) loopOf[b] = id;
+    loops.push_back(l);
+  }
+}
+
+/// get the subroutine
+const subroutine & CFG::get_subroutine() const { return sub; }
+
+/// blocks
+size_t CFG::get_num_blocks() const { return blocks.size(); }
+const basicBlock & CFG::get_block(size_t b) const { return blocks[b]; }
+const vector<basicBlock> & CFG::get_blocks() const { return blocks; }
+size_t CFG::get_block_of(size_t pc) const { return blockOf[pc]; }
+
+/// block starting at the target of the jump ending block 'b' (an
+/// undefined label resolves to the end of the code, which has no block)
+size_t CFG::get_jump_target(size_t b) const {
+  const instruction &i = sub.get_instructions()[blocks[b].last-1];
+  size_t pc = sub.get_jump_pc(i);
+  return pc < blockOf.size() ? blockOf[pc] : NONE;
+}
+
+/// reverse postorder
+const vector<size_t> & CFG::get_rpo() const { return rpo; }
+size_t CFG::get_rpo_index(size_t b) const { return rpoIndex[b]; }
+bool CFG::is_reachable(size_t b) const { return rpoIndex[b] != NONE; }
+
+/// dominators
+size_t CFG::get_idom(size_t b) const { return blocks[b].idom; }
+bool CFG::dominates(size_t a, size_t b) const {
+  if (not is_reachable(a) or not is_reachable(b)) return false;
+  return domPre[a] <= domPre[b] and domPost[b] <= domPost[a];
+}
+
+/// loops
+const vector<loop> & CFG::get_loops() const { return loops; }
+size_t CFG::get_loop_of(size_t b) const { return loopOf[b]; }
+size_t CFG::get_loop_depth(size_t b) const { return loopOf[b] == NONE ? 0 : loops[loopOf[b]].depth; }
+
+/// print (for debugging)
+void CFG::dump(ostream &os) const {
+  os << "cfg " << sub.get_name() << "\n";
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    const basicBlock &bb = blocks[b];
+    os << "  B" << b << " [" << bb.first << "," << bb.last << ")";
+    if (not is_reachable(b)) os << " unreachable";
+    os << " succs:";
+    for (size_t s : bb.succs) os << " B" << s;
+    os << " preds:";
+    for (size_t p : bb.preds) os << " B" << p;
+    if (bb.idom != NONE) os << " idom: B" << bb.idom;
+    if (loopOf[b] != NONE) os << " loop: " << loopOf[b];
+    os << "\n";
+  }
+  for (size_t l = 0; l < loops.size(); ++l) {
+    os << "  loop " << l << " header: B" << loops[l].header << " depth: " << loops[l].depth;
+    if (loops[l].parent != NONE) os << " parent: " << loops[l].parent;
+    os << " blocks:";
+    for (size_t b : loops[l].blocks) os << " B" << b;
+    os << "\n";
+  }
+}
@@ -0,0 +1,147 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CFG - Basic blocks and control flow graph of a subroutine
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "code.h"
+
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class basicBlock is a maximal straight-line range of instructions
+/// [first, last) of a subroutine. A block starts at a LABEL or after a
+/// jump or RETURN, and only its last instruction may transfer control.
+
+class basicBlock {
+public:
+  /// range of instructions in the subroutine
+  size_t first, last;
+  /// successor and predecessor blocks
+  std::vector<size_t> succs;
+  std::vector<size_t> preds;
+  /// immediate dominator (CFG::NONE for the entry and unreachable blocks)
+  size_t idom;
+  /// blocks immediately dominated by this one
+  std::vector<size_t> dom_children;
+
+  basicBlock(size_t f, size_t l);
+  /// number of instructions in the block
+  size_t size() const;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class loop is a natural loop: a header plus all blocks that reach
+/// one of its back edges (latches) without going through the header
+
+class loop {
+public:
+  /// block that dominates the whole loop
+  size_t header;
+  /// sources of the back edges to the header
+  std::vector<size_t> latches;
+  /// all blocks in the loop (sorted, including header and nested loops)
+  std::vector<size_t> blocks;
+  /// innermost enclosing loop (CFG::NONE if outermost), and nesting depth (from 1)
+  size_t parent;
+  size_t depth;
+
+  /// check whether given block belongs to the loop
+  bool contains(size_t b) const;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class CFG builds the basic blocks, edges, dominator tree and loop
+/// nesting of a subroutine. Blocks are index ranges over the
+/// instruction vector, so building is linear and the graph can be
+/// rebuilt after each pass that changes the instructions (an existing
+/// CFG is not updated when the subroutine changes).
+
+class CFG {
+private:
+  /// the subroutine the graph describes
+  const subroutine &sub;
+  /// blocks, in instruction order (block 0 is the entry)
+  std::vector<basicBlock> blocks;
+  /// block of each instruction
+  std::vector<size_t> blockOf;
+  /// reachable blocks in reverse postorder, and position of each block in it
+  std::vector<size_t> rpo;
+  std::vector<size_t> rpoIndex;
+  /// preorder interval of each block in the dominator tree
+  std::vector<size_t> domPre, domPost;
+  /// natural loops (outer loops before the loops they contain)
+  std::vector<loop> loops;
+  /// innermost loop of each block
+  std::vector<size_t> loopOf;
+
+  void build_blocks();
+  void build_rpo();
+  void build_dominators();
+  void build_loops();
+  void add_edge(size_t from, size_t to);
+
+public:
+  /// value for "no block" / "no loop"
+  static const size_t NONE;
+
+  /// build the graph for given subroutine
+  CFG(const subroutine &s);
+
+  /// get the subroutine
+  const subroutine & get_subroutine() const;
+
+  /// blocks
+  size_t get_num_blocks() const;
+  const basicBlock & get_block(size_t b) const;
+  const std::vector<basicBlock> & get_blocks() const;
+  /// block holding given instruction
+  size_t get_block_of(size_t pc) const;
+  /// block starting at the target of the jump ending block 'b'
+  /// (NONE if it jumps to an undefined label)
+  size_t get_jump_target(size_t b) const;
+
+  /// reachable blocks in reverse postorder (entry first)
+  const std::vector<size_t> & get_rpo() const;
+  /// position of the block in get_rpo() (NONE if unreachable)
+  size_t get_rpo_index(size_t b) const;
+  bool is_reachable(size_t b) const;
+
+  /// dominators
+  size_t get_idom(size_t b) const;
+  /// true if every path from the entry to 'b' goes through 'a' (a dominates a)
+  bool dominates(size_t a, size_t b) const;
+
+  /// loops
+  const std::vector<loop> & get_loops() const;
+  /// innermost loop containing the block (NONE if none)
+  size_t get_loop_of(size_t b) const;
+  /// number of loops containing the block
+  size_t get_loop_depth(size_t b) const;
+
+  /// print blocks, edges, dominators and loops (for debugging)
+  void dump(std::ostream &os) const;
+};
@@ -0,0 +1,137 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CopyPropagation - Copy propagation and move coalescing
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "CopyPropagation.h"
+#include "CFG.h"
+#include "Dataflow.h"
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'copyPropagation'
+
+/// propagate copies in a subroutine in SSA form
+size_t copyPropagation::run(ssaForm &f) {
+  const CFG &cfg = f.get_cfg();
+  vector<instruction> &ins = f.get_instructions();
+
+  // source of each copied temporal, and the copy
+  unordered_map<uint32_t, pair<operand, size_t>> source;
+  for (size_t b = 0; b < cfg.get_num_blocks(); ++b) {
+    if (not cfg.is_reachable(b)) continue;
+    for (size_t pc = cfg.get_block(b).first; pc < cfg.get_block(b).last; ++pc) {
+      const instruction &i = ins[pc];
+      if (i.oper != instruction::_LOAD or not i.arg1.is_temp()) continue;
+      // variables that are not renamed may change
+      if (not i.arg2.is_temp() and not f.is_renamed(i.arg2)) continue;
+      source[i.arg1.get_temp()] = make_pair(i.arg2, pc);
+    }
+  }
+  if (source.empty()) return 0;
+
+  // follow chains of copies. An array base (XLOAD, LOADX, ACOPY) must be a
+  // temporal when it is a pointer held in a parameter, so there the
+  // chain stops at the last temporal, whose copy has to stay
+  vector<bool> keep(ins.size(), false);
+  auto find = [&](const operand &o, bool base) -> operand {
+    operand r = o;
+    while (r.is_temp()) {
+      auto p = source.find(r.get_temp());
+      if (p == source.end()) break;
+      if (base and not p->second.first.is_temp()) {
+        keep[p->second.second] = true;
+        break;
+      }
+      r = p->second.first;
+    }
+    return r;
+  };
+  for (size_t b = 0; b < cfg.get_num_blocks(); ++b) {
+    if (not cfg.is_reachable(b)) continue;
+    for (auto &phi : f.get_phis(b))
+      for (auto &a : phi.args) a = find(a, false);
+    for (size_t pc = cfg.get_block(b).first; pc < cfg.get_block(b).last; ++pc) {
+      instruction &i = ins[pc];
+      if (i.oper == instruction::_LOAD and i.arg1.is_temp() and source.count(i.arg1.get_temp())) continue;
+      for (int k = 1; k <= 3; ++k) {
+        bool base = (i.oper == instruction::_XLOAD and k == 1) or (i.oper == instruction::_LOADX and k == 2) or
+                    (i.oper == instruction::_ACOPY and k != 3);
+        if (i.uses_arg(k)) i.get_arg(k) = find(i.get_arg(k), base);
+      }
+    }
+  }
+
+  size_t removed = 0;
+  for (auto &c : source) {
+    if (keep[c.second.second]) continue;
+    ins[c.second.second] = instruction::NOOP();
+    ++removed;
+  }
+  return removed;
+}
+
+/// write results directly to the destination of the move that follows them
+size_t copyPropagation::coalesce(subroutine &s) {
+  const vector<instruction> &ins = s.get_instructions();
+  CFG g(s);
+  liveness lv(g);
+  const varIndex &vars = lv.get_vars();
+
+  // moves 'd = %t' where %t is written by the previous instruction
+  // (in the same block) and dead afterwards
+  vector<bool> fold(ins.size(), false);
+  size_t folded = 0;
+  bitVector live;
+  for (size_t b = 0; b < g.get_num_blocks(); ++b) {
+    const basicBlock &bb = g.get_block(b);
+    live = lv.get_out(b);
+    for (size_t pc = bb.last; pc-- > bb.first; ) {
+      const instruction &i = ins[pc];
+      if (pc > bb.first and i.oper == instruction::_LOAD and i.arg2.is_temp() and
+          i.arg1 != i.arg2 and not live.test(vars.get_index(i.arg2)) and
+          ins[pc-1].defines_arg1() and ins[pc-1].arg1 == i.arg2) {
+        fold[pc] = true;
+        ++folded;
+      }
+      lv.step_back(i, live);
+    }
+  }
+  if (folded == 0) return 0;
+
+  vector<instruction> out;
+  out.reserve(ins.size() - folded);
+  for (size_t pc = 0; pc < ins.size(); ++pc) {
+    if (fold[pc]) {
+      out.back().arg1 = ins[pc].arg1;
+      continue;
+    }
+    out.push_back(ins[pc]);
+  }
+  s.set_instructions(out);
+  return folded;
+}
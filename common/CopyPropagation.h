@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CopyPropagation - Copy propagation and move coalescing
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+#include "code.h"
+#include "SSA.h"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class copyPropagation removes the moves that CodeGenVisitor leaves
+/// between the computation of a value and its final destination
+/// (e.g. '%5 = n', '%6 = %5 + %4', 'x = %6').
+///
+/// In SSA form (run), every use of the destination of a copy reads the
+/// source instead, and the copy is removed. The source may be a
+/// temporal or a variable that keeps its value on entry during the
+/// whole subroutine (a parameter or a local that is renamed and never
+/// written). Variables in memory and '_result' are not propagated.
+///
+/// Out of SSA form (coalesce), a temporal computed just to be copied
+/// into its destination by the next instruction is replaced by that
+/// destination, so the result is written there directly. Moves between
+/// temporals that remain are coalesced by tempAllocator.
+
+class copyPropagation {
+public:
+  /// propagate copies in a subroutine in SSA form. Returns the number
+  /// of copies removed
+  static size_t run(ssaForm &f);
+  /// write results directly to the destination of the move that
+  /// follows them. Returns the number of moves removed
+  static size_t coalesce(subroutine &s);
+};
@@ -0,0 +1,297 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Dataflow - Bit-vector dataflow analyses over a CFG
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#include "Dataflow.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'bitVector'
+
+bitVector::bitVector(size_t n) : words((n + 63) / 64, 0), nbits(n) {}
+
+size_t bitVector::size() const { return nbits; }
+void bitVector::resize(size_t n) { nbits = n; words.assign((n + 63) / 64, 0); }
+
+bool bitVector::test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+void bitVector::set(size_t i) { words[i >> 6] |= uint64_t(1) << (i & 63); }
+void bitVector::reset(size_t i) { words[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+
+void bitVector::clear() { for (auto &w : words) w = 0; }
+void bitVector::set_all() {
+  for (auto &w : words) w = ~uint64_t(0);
+  // keep the bits past the end clear, so that count and == work
+  if (nbits % 64 != 0) words.back() = (uint64_t(1) << (nbits % 64)) - 1;
+}
+
+bool bitVector::union_with(const bitVector &o) {
+  uint64_t changed = 0;
+  for (size_t k = 0; k < words.size(); ++k) {
+    uint64_t w = words[k] | o.words[k];
+    changed |= w ^ words[k];
+    words[k] = w;
+  }
+  return changed != 0;
+}
+bool bitVector::intersect_with(const bitVector &o) {
+  uint64_t changed = 0;
+  for (size_t k = 0; k < words.size(); ++k) {
+    uint64_t w = words[k] & o.words[k];
+    changed |= w ^ words[k];
+    words[k] = w;
+  }
+  return changed != 0;
+}
+void bitVector::subtract(const bitVector &o) {
+  for (size_t k = 0; k < words.size(); ++k) words[k] &= ~o.words[k];
+}
+
+bool bitVector::operator==(const bitVector &o) const { return nbits == o.nbits and words == o.words; }
+bool bitVector::operator!=(const bitVector &o) const { return not (*this == o); }
+
+size_t bitVector::count() const {
+  size_t n = 0;
+  for (auto w : words) n += __builtin_popcountll(w);
+  return n;
+}
+
+size_t bitVector::next(size_t i) const {
+  if (i >= nbits) return nbits;
+  size_t k = i >> 6;
+  uint64_t w = words[k] & (~uint64_t(0) << (i & 63));
+  while (w == 0) {
+    if (++k == words.size()) return nbits;
+    w = words[k];
+  }
+  return k*64 + __builtin_ctzll(w);
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'varIndex'
+
+const size_t varIndex::NONE = size_t(-1);
+
+varIndex::varIndex(const subroutine &s) {
+  for (auto &p : s.params) add(operand::NAME(p.name));
+  for (auto &v : s.vars) {
+    size_t i = add(operand::NAME(v.name));
+    if (v.size > 1) memory[i] = true;
+  }
+  for (auto &i : s.get_instructions()) {
+    for (int k = 1; k <= 3; ++k) {
+      if ((k == 1 and i.defines_arg1()) or i.uses_arg(k)) add(i.get_arg(k));
+    }
+    if (i.oper == instruction::_ALOAD and i.arg2.is_name()) memory[get_index(i.arg2)] = true;
+  }
+}
+
+size_t varIndex::add(const operand &o) {
+  size_t i = get_index(o);
+  if (i != NONE) return i;
+  i = vars.size();
+  if (o.is_temp()) {
+    if (o.get_temp() >= tempIdx.size()) tempIdx.resize(o.get_temp() + 1, NONE);
+    tempIdx[o.get_temp()] = i;
+  }
+  else
+    nameIdx.insert(make_pair(o.get_name_id(), i));
+  vars.push_back(o);
+  memory.push_back(false);
+  return i;
+}
+
+size_t varIndex::size() const { return vars.size(); }
+
+size_t varIndex::get_index(const operand &o) const {
+  if (o.is_temp()) return o.get_temp() < tempIdx.size() ? tempIdx[o.get_temp()] : NONE;
+  if (not o.is_name()) return NONE;
+  auto p = nameIdx.find(o.get_name_id());
+  return p == nameIdx.end() ? NONE : p->second;
+}
+
+const operand & varIndex::get_operand(size_t i) const { return vars[i]; }
+bool varIndex::is_memory(size_t i) const { return memory[i]; }
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'dataflow'
+
+dataflow::dataflow(const CFG &g, Direction d, Meet m) : cfg(g), dir(d), meet(m), visits(0) {}
+
+/// size all sets for 'n' elements
+void dataflow::init(size_t n) {
+  size_t nb = cfg.get_num_blocks();
+  gen.assign(nb, bitVector(n));
+  kill.assign(nb, bitVector(n));
+  boundary.resize(n);
+  in.assign(nb, bitVector(n));
+  out.assign(nb, bitVector(n));
+}
+
+/// compute in/out for all blocks
+void dataflow::solve() {
+  const vector<size_t> &rpo = cfg.get_rpo();
+  size_t n = rpo.size();
+  visits = 0;
+  if (n == 0) return;
+
+  // optimistic start for intersection problems
+  if (meet == INTERSECTION) {
+    for (auto &s : in) s.set_all();
+    for (auto &s : out) s.set_all();
+  }
+
+  // position k in the visiting order holds block order(k)
+  auto order = [&](size_t k) { return dir == FORWARD ? rpo[k] : rpo[n-1-k]; };
+  auto position = [&](size_t b) {
+    size_t r = cfg.get_rpo_index(b);
+    return dir == FORWARD ? r : n-1-r;
+  };
+
+  bitVector pending(n), tmp(boundary.size());
+  pending.set_all();
+  size_t k = pending.next(0);
+  while (k < n) {
+    pending.reset(k);
+    size_t b = order(k);
+    ++visits;
+    const basicBlock &bb = cfg.get_block(b);
+    // the meet of the neighbours on the incoming side
+    const vector<size_t> &from = (dir == FORWARD ? bb.preds : bb.succs);
+    bitVector &enter = (dir == FORWARD ? in[b] : out[b]);
+    bitVector &leave = (dir == FORWARD ? out[b] : in[b]);
+    bool first = true;
+    if ((dir == FORWARD and b == 0) or (dir == BACKWARD and from.empty())) {
+      enter = boundary;
+      first = false;
+    }
+    for (size_t p : from) {
+      if (not cfg.is_reachable(p)) continue;
+      const bitVector &v = (dir == FORWARD ? out[p] : in[p]);
+      if (first) { enter = v; first = false; }
+      else if (meet == UNION) enter.union_with(v);
+      else enter.intersect_with(v);
+    }
+
+    tmp = enter;
+    tmp.subtract(kill[b]);
+    tmp.union_with(gen[b]);
+    if (tmp != leave) {
+      leave = tmp;
+      const vector<size_t> &to = (dir == FORWARD ? bb.succs : bb.preds);
+      for (size_t s : to)
+        if (cfg.is_reachable(s)) pending.set(position(s));
+    }
+    // next pending block in order, wrapping around for loops
+    k = pending.next(k);
+    if (k == n) k = pending.next(0);
+  }
+}
+
+const bitVector & dataflow::get_in(size_t b) const { return in[b]; }
+const bitVector & dataflow::get_out(size_t b) const { return out[b]; }
+size_t dataflow::get_visits() const { return visits; }
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'liveness'
+
+liveness::liveness(const CFG &g) : dataflow(g, BACKWARD, UNION), vars(g.get_subroutine()) {
+  init(vars.size());
+  size_t result = vars.get_index(operand::NAME("_result"));
+  if (result != varIndex::NONE) boundary.set(result);
+  memoryVars.resize(vars.size());
+  for (size_t v = 0; v < vars.size(); ++v)
+    if (vars.is_memory(v)) memoryVars.set(v);
+
+  const vector<instruction> &ins = g.get_subroutine().get_instructions();
+  for (size_t b = 0; b < g.get_num_blocks(); ++b) {
+    const basicBlock &bb = g.get_block(b);
+    // gen: used before being defined in the block. kill: defined in the block
+    bitVector &gb = gen[b], &kb = kill[b];
+    for (size_t pc = bb.last; pc-- > bb.first; ) {
+      step_back(ins[pc], gb);
+      if (ins[pc].defines_arg1()) kb.set(vars.get_index(ins[pc].arg1));
+    }
+  }
+  solve();
+}
+
+const varIndex & liveness::get_vars() const { return vars; }
+
+/// live before = uses + (live after - defs)
+void liveness::step_back(const instruction &i, bitVector &live) const {
+  if (i.defines_arg1()) live.reset(vars.get_index(i.arg1));
+  for (int k = 1; k <= 3; ++k)
+    if (i.uses_arg(k)) live.set(vars.get_index(i.get_arg(k)));
+  if (i.oper == instruction::_CALL) live.union_with(memoryVars);
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'reachingDefs'
+
+reachingDefs::reachingDefs(const CFG &g) : dataflow(g, FORWARD, UNION), vars(g.get_subroutine()) {
+  const vector<instruction> &ins = g.get_subroutine().get_instructions();
+  defAt.assign(ins.size(), CFG::NONE);
+  defsOf.resize(vars.size());
+  for (size_t pc = 0; pc < ins.size(); ++pc) {
+    if (not ins[pc].defines_arg1()) continue;
+    defAt[pc] = defPc.size();
+    defsOf[vars.get_index(ins[pc].arg1)].push_back(defPc.size());
+    defPc.push_back(pc);
+  }
+
+  init(defPc.size());
+  // block where each variable was last seen defined
+  vector<size_t> seen(vars.size(), CFG::NONE);
+  for (size_t b = 0; b < g.get_num_blocks(); ++b) {
+    const basicBlock &bb = g.get_block(b);
+    // gen: last definition of each variable in the block. kill: all
+    // definitions of the variables defined in the block
+    for (size_t pc = bb.last; pc-- > bb.first; ) {
+      if (defAt[pc] == CFG::NONE) continue;
+      size_t v = vars.get_index(ins[pc].arg1);
+      if (seen[v] == b) continue;
+      seen[v] = b;
+      gen[b].set(defAt[pc]);
+      for (size_t d : defsOf[v]) kill[b].set(d);
+    }
+  }
+  solve();
+}
+
+const varIndex & reachingDefs::get_vars() const { return vars; }
+size_t reachingDefs::get_num_defs() const { return defPc.size(); }
+size_t reachingDefs::get_def_pc(size_t d) const { return defPc[d]; }
+size_t reachingDefs::get_def_at(size_t pc) const { return defAt[pc]; }
+const vector<size_t> & reachingDefs::get_defs_of(size_t var) const { return defsOf[var]; }
+
+/// reach after = def + (reach before - other defs of the same variable)
+void reachingDefs::step(size_t pc, bitVector &reach) const {
+  size_t d = defAt[pc];
+  if (d == CFG::NONE) return;
+  const instruction &i = cfg.get_subroutine().get_instructions()[pc];
+  for (size_t o : defsOf[vars.get_index(i.arg1)]) reach.reset(o);
+  reach.set(d);
+}
@@ -0,0 +1,204 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Dataflow - Bit-vector dataflow analyses over a CFG
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "code.h"
+#include "CFG.h"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class bitVector is a fixed-size set of small integers, stored as
+/// 64-bit words so that set operations handle 64 elements at a time
+
+class bitVector {
+private:
+  std::vector<uint64_t> words;
+  size_t nbits;
+
+public:
+  bitVector(size_t n = 0);
+
+  /// number of elements the set can hold
+  size_t size() const;
+  /// change the size (and empty the set)
+  void resize(size_t n);
+
+  bool test(size_t i) const;
+  void set(size_t i);
+  void reset(size_t i);
+  /// remove all elements / add all elements
+  void clear();
+  void set_all();
+
+  /// in-place set operations. union and intersection return true if the set changed
+  bool union_with(const bitVector &o);
+  bool intersect_with(const bitVector &o);
+  void subtract(const bitVector &o);
+
+  bool operator==(const bitVector &o) const;
+  bool operator!=(const bitVector &o) const;
+
+  /// number of elements in the set
+  size_t count() const;
+  /// first element >= i (size() if there is none)
+  size_t next(size_t i) const;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class varIndex gives a dense index to every variable, parameter and
+/// temporal used in a subroutine, so they can be members of a bitVector.
+/// Variables that live in memory (arrays and variables whose address
+/// is taken with ALOAD) can be read or written by a call or through a
+/// pointer, so analyses must treat them conservatively.
+
+class varIndex {
+private:
+  /// operand for each index
+  std::vector<operand> vars;
+  /// whether each variable lives in memory
+  std::vector<bool> memory;
+  /// index of each name (by nametable id) and each temporal (by number)
+  std::unordered_map<uint32_t, size_t> nameIdx;
+  std::vector<size_t> tempIdx;
+
+  size_t add(const operand &o);
+
+public:
+  /// value for operands that are not variables (constants, labels...)
+  static const size_t NONE;
+
+  varIndex(const subroutine &s);
+
+  /// number of variables and temporals
+  size_t size() const;
+  /// index of given operand (NONE if it is not a variable or temporal)
+  size_t get_index(const operand &o) const;
+  /// operand for given index
+  const operand & get_operand(size_t i) const;
+  /// whether the variable lives in memory
+  bool is_memory(size_t i) const;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class dataflow solves a gen/kill problem over the blocks of a CFG.
+/// Clients fill 'gen' and 'kill' for each block and the boundary value
+/// (at the entry for forward problems, at the exits for backward ones),
+/// and call solve(). Blocks are visited in reverse postorder (or its
+/// reverse for backward problems), revisiting only the blocks whose
+/// input changed, until nothing changes.
+
+class dataflow {
+public:
+  typedef enum {FORWARD, BACKWARD} Direction;
+  typedef enum {UNION, INTERSECTION} Meet;
+
+protected:
+  const CFG &cfg;
+  Direction dir;
+  Meet meet;
+  /// transfer function of each block: out = gen + (in - kill)
+  std::vector<bitVector> gen, kill;
+  /// value entering the entry block (forward) or leaving exit blocks (backward)
+  bitVector boundary;
+  /// solution
+  std::vector<bitVector> in, out;
+  /// number of block visits done by the last solve()
+  size_t visits;
+
+  /// size all sets for 'n' elements (before filling gen/kill)
+  void init(size_t n);
+  /// compute in/out for all blocks
+  void solve();
+
+public:
+  dataflow(const CFG &g, Direction d, Meet m);
+
+  /// value at the beginning and at the end of a block
+  const bitVector & get_in(size_t b) const;
+  const bitVector & get_out(size_t b) const;
+  /// number of block visits needed to converge
+  size_t get_visits() const;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class liveness computes which variables and temporals may be read
+/// before being written again. '_result' is live at the exit, and a
+/// call reads every variable that lives in memory.
+
+class liveness : public dataflow {
+private:
+  varIndex vars;
+  /// variables that live in memory (read by calls)
+  bitVector memoryVars;
+
+public:
+  liveness(const CFG &g);
+
+  /// variable numbering
+  const varIndex & get_vars() const;
+  /// turn the set of variables live after the instruction into the
+  /// set of variables live before it
+  void step_back(const instruction &i, bitVector &live) const;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class reachingDefs computes which definitions (instructions that
+/// write a variable or temporal) may reach each point without being
+/// overwritten. A use reached by no definition reads the value the
+/// variable had on entry (e.g. a parameter). Writes made by calls or
+/// through pointers to variables in memory are not definitions.
+
+class reachingDefs : public dataflow {
+private:
+  varIndex vars;
+  /// pc of each definition, definition at each pc (NONE if none)
+  std::vector<size_t> defPc;
+  std::vector<size_t> defAt;
+  /// definitions of each variable
+  std::vector<std::vector<size_t>> defsOf;
+
+public:
+  reachingDefs(const CFG &g);
+
+  /// variable numbering
+  const varIndex & get_vars() const;
+  /// definitions
+  size_t get_num_defs() const;
+  size_t get_def_pc(size_t d) const;
+  /// definition made by the instruction at 'pc' (CFG::NONE if it defines nothing)
+  size_t get_def_at(size_t pc) const;
+  /// all definitions of a variable
+  const std::vector<size_t> & get_defs_of(size_t var) const;
+  /// turn the definitions reaching the instruction at 'pc' into those
+  /// reaching the next one
+  void step(size_t pc, bitVector &reach) const;
+};
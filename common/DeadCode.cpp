@@ -0,0 +1,129 @@
+/////////////////////////////////////////////////////////////////
+//
+//    DeadCode - Dead code and dead store elimination
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "DeadCode.h"
+#include "CFG.h"
+#include "Dataflow.h"
+
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+/// whether removing the instruction can only change the value it writes
+static bool removable(const instruction &i) {
+  switch (i.oper) {
+  case instruction::_POP :
+  case instruction::_READI :
+  case instruction::_READF :
+  case instruction::_READC :
+    return false;
+  default :
+    return i.defines_arg1();
+  }
+}
+
+/// the operand is an int or float constant other than zero
+static bool nonzero_const(const operand &o) {
+  return (o.get_kind() == operand::_INTCONST and o.get_int() != 0) or
+         (o.get_kind() == operand::_FLOATCONST and o.get_float() != 0);
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'deadCodeEliminator'
+
+/// remove dead code from the subroutine
+size_t deadCodeEliminator::run(subroutine &s) {
+  size_t total = 0;
+  while (true) {
+    const vector<instruction> &ins = s.get_instructions();
+    CFG g(s);
+    liveness lv(g);
+    const varIndex &vars = lv.get_vars();
+
+    // temporals written only by the load of a constant other than zero
+    unordered_map<uint32_t, bool> nonzero;
+    for (auto &i : ins) {
+      if (not i.defines_arg1() or not i.arg1.is_temp()) continue;
+      bool load = (i.oper == instruction::_ILOAD or i.oper == instruction::_FLOAD) and nonzero_const(i.arg2);
+      auto p = nonzero.insert(make_pair(i.arg1.get_temp(), load));
+      if (not p.second) p.first->second = false;
+    }
+    // a division is kept (as the other passes do) unless its divisor
+    // is known not to be zero, so that it still traps
+    auto traps = [&](const instruction &i) {
+      if (i.oper != instruction::_DIV and i.oper != instruction::_FDIV) return false;
+      if (nonzero_const(i.arg3)) return false;
+      return not (i.arg3.is_temp() and nonzero[i.arg3.get_temp()]);
+    };
+
+    size_t changes = 0;
+    vector<bool> keep(ins.size(), false), dropPop(ins.size(), false);
+    vector<instruction> out;
+    out.reserve(ins.size());
+    bitVector live;
+    for (size_t b = 0; b < g.get_num_blocks(); ++b) {
+      const basicBlock &bb = g.get_block(b);
+      if (not g.is_reachable(b)) {
+        changes += bb.size();
+        continue;
+      }
+      live = lv.get_out(b);
+      for (size_t pc = bb.last; pc-- > bb.first; ) {
+        const instruction &i = ins[pc];
+        bool dead = false;
+        if (i.oper == instruction::_LOAD and i.arg1 == i.arg2)
+          dead = true;
+        else if (removable(i) and not traps(i)) {
+          size_t v = vars.get_index(i.arg1);
+          dead = not vars.is_memory(v) and not live.test(v);
+        }
+        if (dead) {
+          ++changes;
+          continue;
+        }
+        if (i.oper == instruction::_POP and not i.arg1.is_empty() and
+            not live.test(vars.get_index(i.arg1))) {
+          dropPop[pc] = true;
+          ++changes;
+        }
+        keep[pc] = true;
+        lv.step_back(i, live);
+      }
+    }
+
+    for (size_t pc = 0; pc < ins.size(); ++pc) {
+      if (not keep[pc]) continue;
+      out.push_back(ins[pc]);
+      // popped values that are never read
+      if (dropPop[pc]) out.back().arg1 = operand();
+    }
+
+    if (changes == 0) break;
+    total += changes;
+    s.set_instructions(out);
+  }
+  return total;
+}
@@ -0,0 +1,53 @@
+/////////////////////////////////////////////////////////////////
+//
+//    DeadCode - Dead code and dead store elimination
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+#include "code.h"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class deadCodeEliminator removes from a subroutine the blocks that
+/// can not be reached (e.g. the RETURN that CodeGenVisitor appends
+/// after an explicit return) and the instructions whose results are
+/// never read: a temporal or scalar variable written and not live
+/// afterwards, or a copy of a variable onto itself. Input/output,
+/// calls, parameter passing and stores to memory (XLOAD, CLOAD, and
+/// writes to variables that live in memory) are always kept; a POP
+/// whose value is not read just drops it. Divisions are kept too,
+/// unless the divisor is a constant other than zero, since they may
+/// trap (like in LICM and peephole).
+///
+/// Removing an instruction may make the ones computing its operands
+/// dead, so liveness is recomputed and the pass repeated until nothing
+/// changes (within a block this is done in the same backwards walk).
+
+class deadCodeEliminator {
+public:
+  /// remove dead code from the subroutine. Returns the number of
+  /// instructions removed or simplified
+  static size_t run(subroutine &s);
+};
@@ -0,0 +1,361 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Inliner - Inline expansion of small subroutines
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "Inliner.h"
+#include "CFG.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+
+using namespace std;
+
+/// callees bigger than this are never expanded
+static const size_t MAX_CALLEE = 40;
+/// callers are not grown beyond this size
+static const size_t MAX_CALLER = 10000;
+
+/// number of the greatest temporal used in the instructions
+static uint32_t max_temp(const vector<instruction> &ins) {
+  uint32_t m = 0;
+  for (auto &i : ins)
+    for (int k = 1; k <= 3; ++k)
+      if (i.get_arg(k).is_temp()) m = max(m, i.get_arg(k).get_temp());
+  return m;
+}
+
+/// the subroutine takes the address of one of its parameters (it would
+/// point to the copy of the argument, not to a parameter slot)
+static bool takes_param_address(const subroutine &s) {
+  for (auto &i : s.get_instructions()) {
+    if (i.oper != instruction::_ALOAD or not i.arg2.is_name()) continue;
+    for (auto &p : s.params)
+      if (p.name == i.arg2.get_name()) return true;
+  }
+  return false;
+}
+
+/// argument k of the instruction is the base of an array
+static bool is_array_base(const instruction &i, int k) {
+  return (i.oper == instruction::_XLOAD and k == 1) or (i.oper == instruction::_LOADX and k == 2) or
+         (i.oper == instruction::_ACOPY and k != 3);
+}
+
+/// the subroutine calls no other
+static bool is_leaf(const subroutine &s) {
+  for (auto &i : s.get_instructions())
+    if (i.oper == instruction::_CALL) return false;
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'inliner'
+
+inliner::inliner(code &c) : prog(c), copies(0) {
+  const vector<subroutine> &subs = prog.get_subroutines();
+  size_t n = subs.size();
+  callees.resize(n);
+  for (size_t s = 0; s < n; ++s) {
+    for (auto &i : subs[s].get_instructions()) {
+      if (i.oper != instruction::_CALL) continue;
+      size_t g = index_of(i.arg1.get_name());
+      if (g != n and find(callees[s].begin(), callees[s].end(), g) == callees[s].end())
+        callees[s].push_back(g);
+    }
+  }
+  // transitive closure, one search per subroutine
+  reaches.assign(n, vector<bool>(n, false));
+  for (size_t s = 0; s < n; ++s) {
+    vector<size_t> work = callees[s];
+    while (not work.empty()) {
+      size_t g = work.back();
+      work.pop_back();
+      if (reaches[s][g]) continue;
+      reaches[s][g] = true;
+      for (size_t h : callees[g]) work.push_back(h);
+    }
+  }
+}
+
+/// position of the subroutine in the program (number of subroutines if not found)
+size_t inliner::index_of(const string &name) const {
+  const vector<subroutine> &subs = prog.get_subroutines();
+  for (size_t s = 0; s < subs.size(); ++s)
+    if (subs[s].get_name() == name) return s;
+  return subs.size();
+}
+
+/// a name made from 'base' that is not in 'used' (which now holds it)
+string inliner::fresh(unordered_set<string> &used, const string &base) const {
+  string name = base + "_" + to_string(copies);
+  for (size_t n = 1; used.count(name); ++n)
+    name = base + "_" + to_string(copies) + "_" + to_string(n);
+  used.insert(name);
+  return name;
+}
+
+/// size of the code of a subroutine (without labels)
+size_t inliner::size_of(const subroutine &s) {
+  size_t n = 0;
+  for (auto &i : s.get_instructions())
+    if (i.oper != instruction::_LABEL and i.oper != instruction::_NOOP) ++n;
+  return n;
+}
+
+/// a call costs a PUSH and a POP per argument and for the result,
+/// plus the CALL and the frame. Callees about that size are always
+/// worth copying, and small leaf callees are when called in a loop
+bool inliner::worth(size_t callee, size_t nargs, bool inLoop) const {
+  const subroutine &g = prog.get_subroutines()[callee];
+  size_t sz = size_of(g);
+  if (sz <= 2*(nargs+1) + 8) return true;
+  return inLoop and sz <= MAX_CALLEE and is_leaf(g);
+}
+
+/// expand the calls in subroutine 'caller'. Returns how many
+size_t inliner::expand_calls(size_t caller) {
+  subroutine &s = prog.get_subroutines()[caller];
+  const vector<instruction> &ins = s.get_instructions();
+  size_t nsubs = prog.get_subroutines().size();
+  CFG cfg(s);
+
+  uint32_t next = max_temp(ins) + 1;
+  size_t size = size_of(s);
+  usedNames.clear();
+  usedLabels.clear();
+  for (auto &p : s.params) usedNames.insert(p.name);
+  for (auto &v : s.vars) usedNames.insert(v.name);
+  for (auto &i : ins)
+    if (i.oper == instruction::_LABEL) usedLabels.insert(i.arg1.get_name());
+  map<size_t, vector<instruction>> edits;
+  size_t expanded = 0;
+  for (size_t pc = 0; pc < ins.size() and size < MAX_CALLER; ++pc) {
+    if (ins[pc].oper != instruction::_CALL) continue;
+    size_t g = index_of(ins[pc].arg1.get_name());
+    // recursive calls are left alone
+    if (g == nsubs or g == caller or reaches[g][caller]) continue;
+    const subroutine &callee = prog.get_subroutines()[g];
+    if (callee.params.empty() or takes_param_address(callee)) continue;
+    size_t nargs = callee.params.size() - 1;
+    if (not worth(g, nargs, cfg.get_loop_depth(cfg.get_block_of(pc)) > 0)) continue;
+
+    // the result slot is pushed empty
+    vector<size_t> pushes;
+    if (not s.match_call(pc, nargs, pushes) or not ins[pushes[0]].arg1.is_empty()) continue;
+
+    expand(s, pc, pushes, callee, next, edits);
+    size += size_of(callee);
+    ++expanded;
+  }
+  if (expanded == 0) return 0;
+
+  vector<instruction> out;
+  out.reserve(ins.size() + size);
+  for (size_t pc = 0; pc < ins.size(); ++pc) {
+    auto e = edits.find(pc);
+    if (e == edits.end())
+      out.push_back(ins[pc]);
+    else
+      out.insert(out.end(), e->second.begin(), e->second.end());
+  }
+  s.set_instructions(out);
+  return expanded;
+}
+
+/// expand the call at 'pc' of 'caller'
+void inliner::expand(subroutine &caller, size_t pc, const vector<size_t> &pushes,
+                     const subroutine &callee, uint32_t &next,
+                     map<size_t, vector<instruction>> &edits) {
+  const vector<instruction> &ins = caller.get_instructions();
+  const vector<instruction> &body = callee.get_instructions();
+  ++copies;
+  uint32_t base = next;
+  next += max_temp(body);
+
+  // what each name of the callee becomes in the copy
+  unordered_map<string, operand> names;
+  // parameters that are arrays of the caller, used by name
+  unordered_map<string, operand> arrays;
+  size_t k = 0;
+  for (auto &p : callee.params) {
+    const instruction &push = ins[pushes[k]];
+    if (k == 0) {
+      // the result is a temporal that the last POP copies
+      operand r = operand::TEMP(next++);
+      names[p.name] = r;
+      edits[pushes[k]];
+      const operand &dst = ins[pc + pushes.size()].arg1;
+      if (dst.is_empty()) edits[pc + pushes.size()];
+      else edits[pc + pushes.size()].push_back(instruction::LOAD(dst, r));
+    }
+    else {
+      edits[pc + k];
+      // the address of a local array of the caller, taken just for the call
+      const instruction &prev = ins[pushes[k]-1];
+      bool local = false;
+      if (prev.oper == instruction::_ALOAD and prev.arg1 == push.arg1 and prev.arg1.is_temp())
+        for (auto &v : caller.vars)
+          if (v.size > 1 and v.name == prev.arg2.get_name()) local = true;
+      if (local) {
+        arrays[p.name] = prev.arg2;
+        edits[pushes[k]-1];
+        edits[pushes[k]];
+      }
+      else {
+        operand t = operand::TEMP(next++);
+        names[p.name] = t;
+        edits[pushes[k]].push_back(instruction::LOAD(t, push.arg1));
+      }
+    }
+    ++k;
+  }
+  // scalar locals become temporals, arrays (even of size 1, seen by
+  // their use as an array base) and addressed locals become locals of
+  // the caller
+  unordered_map<string, bool> inMemory;
+  for (auto &i : body) {
+    if (i.oper == instruction::_ALOAD and i.arg2.is_name()) inMemory[i.arg2.get_name()] = true;
+    for (int k = 1; k <= 3; ++k)
+      if (is_array_base(i, k) and i.get_arg(k).is_name()) inMemory[i.get_arg(k).get_name()] = true;
+  }
+  for (auto &v : callee.vars) {
+    if (v.size > 1 or inMemory.count(v.name)) {
+      string name = fresh(usedNames, v.name);
+      caller.add_var(name, v.size);
+      names[v.name] = operand::NAME(name);
+    }
+    else
+      names[v.name] = operand::TEMP(next++);
+  }
+
+  auto rename = [&](const operand &o) {
+    if (o.is_temp()) return operand::TEMP(base + o.get_temp() - 1);
+    if (o.is_name()) {
+      auto n = names.find(o.get_name());
+      if (n != names.end()) return n->second;
+    }
+    return o;
+  };
+  unordered_map<string, string> labels;
+  auto relabel = [&](const operand &l) {
+    auto n = labels.find(l.get_name());
+    if (n == labels.end()) n = labels.insert({l.get_name(), fresh(usedLabels, l.get_name())}).first;
+    return operand::LABEL(n->second);
+  };
+  string end = fresh(usedLabels, "inline");
+
+  vector<instruction> copy;
+  copy.reserve(body.size() + 1);
+  for (auto &i : body) {
+    switch (i.oper) {
+    case instruction::_LABEL :
+      copy.push_back(instruction::LABEL(relabel(i.arg1).get_name()));
+      break;
+    case instruction::_UJUMP :
+      copy.push_back(instruction::UJUMP(relabel(i.arg1).get_name()));
+      break;
+    case instruction::_FJUMP :
+      copy.push_back(instruction::FJUMP(rename(i.arg1), relabel(i.arg2).get_name()));
+      break;
+    case instruction::_CALL :
+      copy.push_back(i);
+      break;
+    case instruction::_RETURN :
+      copy.push_back(instruction::UJUMP(end));
+      break;
+    case instruction::_LOAD :
+      // a pointer to an array parameter is now the address of the array
+      if (i.arg2.is_name() and arrays.count(i.arg2.get_name())) {
+        copy.push_back(instruction::ALOAD(rename(i.arg1), arrays[i.arg2.get_name()]));
+        break;
+      }
+      // fall through
+    default :
+      copy.push_back(instruction(i.oper, rename(i.arg1), rename(i.arg2),
+                                 i.is_compare_jump() ? relabel(i.arg3) : rename(i.arg3)));
+    }
+  }
+  copy.push_back(instruction::LABEL(end));
+
+  // temporals holding the address of an array argument only to index
+  // it are replaced by the array itself
+  unordered_map<uint32_t, size_t> defs;
+  for (auto &i : copy)
+    if (i.defines_arg1() and i.arg1.is_temp()) ++defs[i.arg1.get_temp()];
+  unordered_map<uint32_t, operand> direct;
+  for (auto &i : copy)
+    if (i.oper == instruction::_ALOAD and i.arg1.is_temp() and defs[i.arg1.get_temp()] == 1)
+      for (auto &a : arrays)
+        if (a.second == i.arg2) direct[i.arg1.get_temp()] = i.arg2;
+  for (auto &i : copy) {
+    for (int k = 1; k <= 3; ++k) {
+      const operand &o = i.get_arg(k);
+      if (not o.is_temp() or not direct.count(o.get_temp())) continue;
+      bool def = (i.oper == instruction::_ALOAD and k == 1);
+      if (not is_array_base(i, k) and not def) direct.erase(o.get_temp());
+    }
+  }
+  vector<instruction> &out = edits[pc];
+  out.reserve(copy.size());
+  for (auto &i : copy) {
+    if (i.oper == instruction::_ALOAD and i.arg1.is_temp() and direct.count(i.arg1.get_temp())) continue;
+    instruction j = i;
+    for (int k = 1; k <= 3; ++k) {
+      operand &o = j.get_arg(k);
+      if (is_array_base(j, k) and o.is_temp() and direct.count(o.get_temp())) o = direct[o.get_temp()];
+    }
+    out.push_back(j);
+  }
+}
+
+/// expand calls in the whole program, callees first
+size_t inliner::run(code &c) {
+  inliner in(c);
+  size_t n = c.get_subroutines().size();
+  vector<bool> done(n, false);
+  vector<pair<size_t, size_t>> stack;   // (subroutine, next callee to visit)
+  size_t expanded = 0;
+  for (size_t s = 0; s < n; ++s) {
+    if (done[s]) continue;
+    done[s] = true;
+    stack.push_back(make_pair(s, 0));
+    while (not stack.empty()) {
+      size_t f = stack.back().first;
+      size_t &k = stack.back().second;
+      if (k < in.callees[f].size()) {
+        size_t g = in.callees[f][k++];
+        if (not done[g]) {
+          done[g] = true;
+          stack.push_back(make_pair(g, 0));
+        }
+      }
+      else {
+        expanded += in.expand_calls(f);
+        stack.pop_back();
+      }
+    }
+  }
+  return expanded;
+}
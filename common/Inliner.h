@@ -0,0 +1,87 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Inliner - Inline expansion of small subroutines
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+#include "code.h"
+
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class inliner replaces calls to small subroutines by a copy of
+/// their code, saving the PUSH/POP of the arguments and result, the
+/// CALL and the frame set up by tvm.
+///
+/// Subroutines are handled callees first, so a callee is inlined
+/// with the calls in it already expanded. A call is expanded when the
+/// callee does not (directly or not) call the caller, and its size is
+/// close to the cost of the call, or a bit larger for leaf callees
+/// called in a loop. In the copy, parameters, '_result' and scalar
+/// locals become fresh temporals, local arrays become new locals of
+/// the caller, labels and temporals are renamed (to names the caller
+/// does not use), and RETURN jumps to the end. An array argument that is a local array of the caller is
+/// used directly by name instead of through the pointer parameter.
+///
+/// Must run on the code from CodeGenVisitor, before the optimizer
+/// reuses temporals.
+
+class inliner {
+private:
+  code &prog;
+  /// subroutines called by each subroutine (by index)
+  std::vector<std::vector<size_t>> callees;
+  /// whether each subroutine reaches each other one through calls
+  std::vector<std::vector<bool>> reaches;
+  /// number of calls expanded so far (to name copies)
+  size_t copies;
+  /// names of variables and labels in the caller being expanded
+  std::unordered_set<std::string> usedNames, usedLabels;
+
+  inliner(code &c);
+  size_t index_of(const std::string &name) const;
+  /// a name made from 'base' that is not in 'used' (which now holds it)
+  std::string fresh(std::unordered_set<std::string> &used, const std::string &base) const;
+  /// size of the code of a subroutine (without labels)
+  static size_t size_of(const subroutine &s);
+  /// check whether a call to 'callee' with 'nargs' arguments should be expanded
+  bool worth(size_t callee, size_t nargs, bool inLoop) const;
+  /// expand the calls in subroutine 'caller'. Returns how many
+  size_t expand_calls(size_t caller);
+  /// expand the call at 'pc' of 'caller', whose result slot and
+  /// arguments are pushed at 'pushes'. The instructions replacing each
+  /// pc are added to 'edits', and new temporals numbered from 'next'
+  void expand(subroutine &caller, size_t pc, const std::vector<size_t> &pushes,
+              const subroutine &callee, uint32_t &next,
+              std::map<size_t, std::vector<instruction>> &edits);
+
+public:
+  /// expand calls in the whole program. Returns the number of calls expanded
+  static size_t run(code &c);
+};
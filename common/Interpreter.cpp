@@ -0,0 +1,272 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Interpreter - Execution of t-code programs
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "Interpreter.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'interpreter'
+
+/// 8M cells: deep recursion and big local arrays are fine
+const size_t interpreter::STACK_CELLS = size_t(1) << 23;
+
+interpreter::interpreter(const code &c, size_t stackCells) : prog(c), stack(stackCells) {}
+
+/// message for the error that stopped the program
+const string & interpreter::get_error() const { return error; }
+
+/// record an error message
+bool interpreter::fail(const string &msg) {
+  error = msg;
+  return false;
+}
+
+/// resolve all subroutines
+bool interpreter::prepare() {
+  const vector<subroutine> &subs = prog.get_subroutines();
+  unordered_map<string, size_t> index;
+  for (size_t n = 0; n < subs.size(); ++n) index.insert(make_pair(subs[n].get_name(), n));
+
+  routines.assign(subs.size(), routine());
+  for (size_t n = 0; n < subs.size(); ++n) {
+    const subroutine &s = subs[n];
+    routine &r = routines[n];
+    r.name = s.get_name();
+    r.nparams = s.params.size();
+
+    // frame offset of each variable, and whether it is an array: as in
+    // tvm, locals (even of size 1) live in the frame and only parameters
+    // hold pointers
+    unordered_map<uint32_t, pair<size_t, bool>> vars;
+    size_t offset = 0;
+    for (auto &p : s.params) vars[nametable::intern(p.name)] = make_pair(offset++, false);
+    for (auto &v : s.vars) {
+      vars[nametable::intern(v.name)] = make_pair(offset, true);
+      offset += v.size;
+    }
+    const vector<instruction> &ins = s.get_instructions();
+    size_t temps = 0;
+    for (auto &i : ins)
+      for (int k = 1; k <= 3; ++k)
+        if (i.get_arg(k).is_temp()) temps = max(temps, size_t(i.get_arg(k).get_temp()) + 1);
+    r.frameSize = offset + temps;
+    // computed in size_t, so that huge sizes or temporal numbers can not
+    // wrap around; a frame that big would never fit in the stack anyway
+    if (r.frameSize > stack.size() or r.frameSize > UINT32_MAX)
+      return fail("stack overflow in function " + r.name);
+
+    // one more RETURN, for the code that falls off the end
+    r.steps.resize(ins.size() + 1);
+    r.steps.back().oper = instruction::_RETURN;
+    for (size_t pc = 0; pc < ins.size(); ++pc) {
+      const instruction &i = ins[pc];
+      step &st = r.steps[pc];
+      st.oper = i.oper;
+      st.target = 0;
+      for (int k = 1; k <= 3; ++k) {
+        const operand &o = i.get_arg(k);
+        slot &a = st.arg[k-1];
+        a.kind = slot::NONE;
+        a.array = false;
+        a.offset = 0;
+        a.value.p = nullptr;
+        switch (o.get_kind()) {
+        case operand::_TEMP :
+          a.kind = slot::FRAME;
+          a.offset = offset + o.get_temp();
+          break;
+        case operand::_NAME : {
+          if (i.oper == instruction::_CALL) break;
+          auto v = vars.find(o.get_name_id());
+          if (v == vars.end()) return fail("unknown variable '" + o.get_name() + "' in function " + r.name);
+          a.kind = slot::FRAME;
+          a.offset = v->second.first;
+          a.array = v->second.second;
+          break;
+        }
+        case operand::_INTCONST : a.kind = slot::IMMEDIATE; a.value.i = o.get_int(); break;
+        case operand::_CHARCONST : a.kind = slot::IMMEDIATE; a.value.i = o.get_char(); break;
+        case operand::_FLOATCONST : a.kind = slot::IMMEDIATE; a.value.f = o.get_float(); break;
+        default : break;
+        }
+      }
+      if (i.is_jump()) {
+        if (not s.has_label(i.get_jump_label()))
+          return fail("unknown label '" + i.get_jump_label().get_name() + "' in function " + r.name);
+        st.target = s.get_jump_pc(i);
+      }
+      else if (i.oper == instruction::_CALL) {
+        auto g = index.find(i.arg1.get_name());
+        if (g == index.end()) return fail("unknown function '" + i.arg1.get_name() + "' called in function " + r.name);
+        st.target = g->second;
+      }
+      else if (i.oper == instruction::_WRITES) {
+        if (st.arg[0].kind != slot::IMMEDIATE or size_t(st.arg[0].value.i) >= prog.get_strings().size())
+          return fail("unknown string constant in function " + r.name);
+      }
+    }
+  }
+  return true;
+}
+
+/// run subroutine "main"
+bool interpreter::run(istream &in, ostream &out) {
+  error.clear();
+  if (not prepare()) return false;
+  size_t cur = routines.size();
+  for (size_t n = 0; n < routines.size(); ++n)
+    if (routines[n].name == "main") cur = n;
+  if (cur == routines.size()) return fail("no function main");
+
+  const vector<string> &strings = prog.get_strings();
+  vector<activation> calls;
+  size_t pc = 0, fp = 0, sp = 0;
+  cell *frame = nullptr;
+  // start running routine 'cur' with its parameters at 'fp'
+  auto enter = [&]() -> bool {
+    const routine &r = routines[cur];
+    if (fp + r.frameSize > stack.size()) return fail("stack overflow in function " + r.name);
+    frame = &stack[fp];
+    for (size_t k = r.nparams; k < r.frameSize; ++k) frame[k].p = nullptr;
+    sp = fp + r.frameSize;
+    pc = 0;
+    return true;
+  };
+  auto val = [&](const slot &a) -> cell { return a.kind == slot::FRAME ? frame[a.offset] : a.value; };
+  auto ref = [&](const slot &a) -> cell & { return frame[a.offset]; };
+  // start of an array: an array variable, or a pointer
+  auto base = [&](const slot &a) -> cell * { return a.array ? &frame[a.offset] : val(a).p; };
+
+  if (not enter()) return false;
+  while (true) {
+    const routine &r = routines[cur];
+    const step &st = r.steps[pc++];
+    const slot *a = st.arg;
+    switch (st.oper) {
+    case instruction::_LABEL : case instruction::_NOOP : break;
+    case instruction::_UJUMP : pc = st.target; break;
+    case instruction::_FJUMP : if (val(a[0]).i == 0) pc = st.target; break;
+    case instruction::_IFEQ : if (val(a[0]).i == val(a[1]).i) pc = st.target; break;
+    case instruction::_IFNEQ : if (not (val(a[0]).i == val(a[1]).i)) pc = st.target; break;
+    case instruction::_IFLT : if (val(a[0]).i < val(a[1]).i) pc = st.target; break;
+    case instruction::_IFNLT : if (not (val(a[0]).i < val(a[1]).i)) pc = st.target; break;
+    case instruction::_IFLE : if (val(a[0]).i <= val(a[1]).i) pc = st.target; break;
+    case instruction::_IFNLE : if (not (val(a[0]).i <= val(a[1]).i)) pc = st.target; break;
+    case instruction::_IFFEQ : if (val(a[0]).f == val(a[1]).f) pc = st.target; break;
+    case instruction::_IFFNEQ : if (not (val(a[0]).f == val(a[1]).f)) pc = st.target; break;
+    case instruction::_IFFLT : if (val(a[0]).f < val(a[1]).f) pc = st.target; break;
+    case instruction::_IFFNLT : if (not (val(a[0]).f < val(a[1]).f)) pc = st.target; break;
+    case instruction::_IFFLE : if (val(a[0]).f <= val(a[1]).f) pc = st.target; break;
+    case instruction::_IFFNLE : if (not (val(a[0]).f <= val(a[1]).f)) pc = st.target; break;
+
+    case instruction::_PUSH :
+      if (sp == stack.size()) return fail("stack overflow in function " + r.name);
+      stack[sp].p = nullptr;
+      if (a[0].kind != slot::NONE) stack[sp] = val(a[0]);
+      ++sp;
+      break;
+    case instruction::_POP :
+      if (sp == fp + r.frameSize) return fail("pop from an empty stack in function " + r.name);
+      --sp;
+      if (a[0].kind != slot::NONE) ref(a[0]) = stack[sp];
+      break;
+    case instruction::_CALL :
+      calls.push_back(activation{cur, pc, fp});
+      cur = st.target;
+      fp = sp - routines[cur].nparams;
+      if (not enter()) return false;
+      break;
+    case instruction::_RETURN :
+      if (calls.empty()) return true;
+      sp = fp + r.nparams;
+      cur = calls.back().routine;
+      pc = calls.back().pc;
+      fp = calls.back().fp;
+      frame = &stack[fp];
+      calls.pop_back();
+      break;
+
+    case instruction::_ADD : ref(a[0]).i = int32_t(uint32_t(val(a[1]).i) + uint32_t(val(a[2]).i)); break;
+    case instruction::_SUB : ref(a[0]).i = int32_t(uint32_t(val(a[1]).i) - uint32_t(val(a[2]).i)); break;
+    case instruction::_MUL : ref(a[0]).i = int32_t(uint32_t(val(a[1]).i) * uint32_t(val(a[2]).i)); break;
+    case instruction::_DIV : {
+      int32_t x = val(a[1]).i, y = val(a[2]).i;
+      if (y == 0) return fail("division by zero in function " + r.name);
+      ref(a[0]).i = (y == -1 ? int32_t(0u - uint32_t(x)) : x / y);
+      break;
+    }
+    case instruction::_EQ : ref(a[0]).i = val(a[1]).i == val(a[2]).i; break;
+    case instruction::_LT : ref(a[0]).i = val(a[1]).i < val(a[2]).i; break;
+    case instruction::_LE : ref(a[0]).i = val(a[1]).i <= val(a[2]).i; break;
+    case instruction::_NEG : ref(a[0]).i = int32_t(0u - uint32_t(val(a[1]).i)); break;
+    case instruction::_NOT : ref(a[0]).i = val(a[1]).i == 0; break;
+    case instruction::_AND : ref(a[0]).i = val(a[1]).i != 0 and val(a[2]).i != 0; break;
+    case instruction::_OR : ref(a[0]).i = val(a[1]).i != 0 or val(a[2]).i != 0; break;
+    case instruction::_FLOAT : ref(a[0]).f = float(val(a[1]).i); break;
+
+    case instruction::_FADD : ref(a[0]).f = val(a[1]).f + val(a[2]).f; break;
+    case instruction::_FSUB : ref(a[0]).f = val(a[1]).f - val(a[2]).f; break;
+    case instruction::_FMUL : ref(a[0]).f = val(a[1]).f * val(a[2]).f; break;
+    case instruction::_FDIV : ref(a[0]).f = val(a[1]).f / val(a[2]).f; break;
+    case instruction::_FEQ : ref(a[0]).i = val(a[1]).f == val(a[2]).f; break;
+    case instruction::_FLT : ref(a[0]).i = val(a[1]).f < val(a[2]).f; break;
+    case instruction::_FLE : ref(a[0]).i = val(a[1]).f <= val(a[2]).f; break;
+    case instruction::_FNEG : ref(a[0]).f = -val(a[1]).f; break;
+
+    case instruction::_LOAD : case instruction::_ILOAD : case instruction::_CHLOAD : case instruction::_FLOAD :
+      ref(a[0]) = val(a[1]);
+      break;
+    case instruction::_XLOAD : base(a[0])[val(a[1]).i] = val(a[2]); break;
+    case instruction::_LOADX : ref(a[0]) = base(a[1])[val(a[2]).i]; break;
+    case instruction::_ALOAD : ref(a[0]).p = &frame[a[1].offset]; break;
+    case instruction::_LOADC : ref(a[0]) = *val(a[1]).p; break;
+    case instruction::_CLOAD : *val(a[0]).p = val(a[1]); break;
+    case instruction::_ACOPY : {
+      cell *dst = base(a[0]), *src = base(a[1]);
+      int32_t n = val(a[2]).i;
+      if (n <= 0 or dst == src) break;
+      if (dst < src) copy(src, src + n, dst);
+      else copy_backward(src, src + n, dst + n);
+      break;
+    }
+
+    case instruction::_READI : { int32_t x = 0; in >> x; ref(a[0]).i = x; break; }
+    case instruction::_READF : { float x = 0; in >> x; ref(a[0]).f = x; break; }
+    case instruction::_READC : { char x = 0; in >> x; ref(a[0]).i = x; break; }
+    case instruction::_WRITEI : out << val(a[0]).i; break;
+    case instruction::_WRITEF : out << val(a[0]).f; break;
+    case instruction::_WRITEC : out << char(val(a[0]).i); break;
+    case instruction::_WRITELN : out << '\n'; break;
+    case instruction::_WRITES : out << strings[a[0].value.i]; break;
+
+    default :
+      return fail("invalid instruction in function " + r.name);
+    }
+  }
+}
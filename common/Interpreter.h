@@ -0,0 +1,113 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Interpreter - Execution of t-code programs
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+#include "code.h"
+
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class interpreter runs a program the way tvm does, plus the
+/// instructions tvm lacks (ACOPY, WRITES).
+///
+/// All values live in one stack of cells. A frame holds the
+/// parameters (pushed by the caller, who pops them after the call),
+/// then the local variables, then the temporals. A pointer is the
+/// address of a cell, so array parameters, ALOAD and LOADC/CLOAD work
+/// on any variable. Operands are resolved to frame offsets or
+/// immediate values once, before running, so each step is a switch
+/// on the operation and a few indexed accesses.
+
+class interpreter {
+private:
+  /// a memory cell: an integer (also booleans and characters), a
+  /// float, or the address of a cell
+  union cell {
+    int32_t i;
+    float f;
+    cell *p;
+  };
+
+  /// an operand resolved for execution
+  struct slot {
+    typedef enum {NONE, FRAME, IMMEDIATE} Kind;
+    Kind kind;
+    /// the variable is an array (so it is its own base address)
+    bool array;
+    /// offset in the frame, or value
+    uint32_t offset;
+    cell value;
+  };
+
+  /// an instruction resolved for execution
+  struct step {
+    instruction::Operation oper;
+    slot arg[3];
+    /// target of jumps, callee of CALL
+    size_t target;
+  };
+
+  /// a subroutine resolved for execution
+  struct routine {
+    std::string name;
+    size_t nparams;
+    /// parameters + locals + temporals
+    size_t frameSize;
+    std::vector<step> steps;
+  };
+
+  /// a subroutine being executed
+  struct activation {
+    size_t routine, pc, fp;
+  };
+
+  const code &prog;
+  std::vector<routine> routines;
+  std::vector<cell> stack;
+  std::string error;
+
+  /// resolve all subroutines. Returns false if some call has no callee
+  bool prepare();
+  /// record an error message
+  bool fail(const std::string &msg);
+
+public:
+  /// default number of cells in the stack
+  static const size_t STACK_CELLS;
+
+  interpreter(const code &c, size_t stackCells = STACK_CELLS);
+
+  /// run subroutine "main", reading and writing given streams.
+  /// Returns false (see get_error) if the program fails
+  bool run(std::istream &in, std::ostream &out);
+  /// message for the error that stopped the program
+  const std::string & get_error() const;
+};
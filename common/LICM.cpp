@@ -0,0 +1,143 @@
+/////////////////////////////////////////////////////////////////
+//
+//    LICM - Loop-invariant code motion
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "LICM.h"
+#include "CFG.h"
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+/// whether the instruction computes a value from its operands alone
+/// (and can be moved as long as they are available)
+static bool movable(const instruction &i, const ssaForm &f) {
+  if (not i.defines_arg1() or not i.arg1.is_temp()) return false;
+  switch (i.oper) {
+  case instruction::_ADD : case instruction::_SUB : case instruction::_MUL : case instruction::_DIV :
+  case instruction::_EQ : case instruction::_LT : case instruction::_LE :
+  case instruction::_NEG : case instruction::_NOT : case instruction::_AND : case instruction::_OR :
+  case instruction::_FLOAT :
+  case instruction::_FADD : case instruction::_FSUB : case instruction::_FMUL : case instruction::_FDIV :
+  case instruction::_FEQ : case instruction::_FLT : case instruction::_FLE : case instruction::_FNEG :
+  case instruction::_LOAD : case instruction::_ILOAD : case instruction::_CHLOAD : case instruction::_FLOAD :
+  case instruction::_ALOAD :
+    break;
+  default :
+    return false;
+  }
+  // variables that are not renamed may change
+  for (int k = 2; k <= 3; ++k)
+    if (i.uses_arg(k) and i.get_arg(k).is_name() and
+        not (i.oper == instruction::_ALOAD or f.is_renamed(i.get_arg(k))))
+      return false;
+  return true;
+}
+
+/// whether the instruction does something besides computing a value
+/// (control flow aside): calls, input/output, writes to memory
+static bool has_effects(const instruction &i) {
+  if (i.is_compare_jump()) return false;
+  switch (i.oper) {
+  case instruction::_LABEL : case instruction::_UJUMP : case instruction::_FJUMP : case instruction::_NOOP :
+  case instruction::_LOADX : case instruction::_LOADC :
+    return false;
+  default :
+    return not i.defines_arg1() or not i.arg1.is_temp();
+  }
+}
+
+static bool may_trap(const instruction &i) {
+  return i.oper == instruction::_DIV or i.oper == instruction::_FDIV;
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'licm'
+
+/// hoist invariant computations
+size_t licm::run(ssaForm &f) {
+  const CFG &cfg = f.get_cfg();
+  vector<instruction> &ins = f.get_instructions();
+
+  // block defining each temporal, and temporals holding a nonzero constant
+  unordered_map<uint32_t, size_t> defBlock;
+  unordered_set<uint32_t> nonzero;
+  for (size_t b = 0; b < cfg.get_num_blocks(); ++b) {
+    if (not cfg.is_reachable(b)) continue;
+    for (auto &phi : f.get_phis(b)) defBlock[phi.dest.get_temp()] = b;
+    for (size_t pc = cfg.get_block(b).first; pc < cfg.get_block(b).last; ++pc) {
+      const instruction &i = ins[pc];
+      if (not i.defines_arg1() or not i.arg1.is_temp()) continue;
+      defBlock[i.arg1.get_temp()] = b;
+      if ((i.oper == instruction::_ILOAD and i.arg2.get_int() != 0) or
+          (i.oper == instruction::_FLOAD and i.arg2.get_float() != 0))
+        nonzero.insert(i.arg1.get_temp());
+    }
+  }
+
+  size_t moved = 0;
+  vector<size_t> order;
+  // outer loops first
+  for (auto &l : cfg.get_loops()) {
+    size_t h = l.header;
+    if (not f.has_preheader(h)) continue;
+    auto invariant = [&](const operand &o) {
+      if (not o.is_temp()) return true;
+      auto p = defBlock.find(o.get_temp());
+      return p != defBlock.end() and not l.contains(p->second);
+    };
+
+    // definitions come before their uses in reverse postorder
+    order.clear();
+    for (size_t b : l.blocks)
+      if (cfg.is_reachable(b)) order.push_back(b);
+    sort(order.begin(), order.end(),
+         [&](size_t a, size_t b) { return cfg.get_rpo_index(a) < cfg.get_rpo_index(b); });
+
+    // still at the start of the header, before any visible effect
+    bool first = true;
+    for (size_t b : order) {
+      if (b != h) first = false;
+      for (size_t pc = cfg.get_block(b).first; pc < cfg.get_block(b).last; ++pc) {
+        const instruction &i = ins[pc];
+        bool hoistable = movable(i, f) and invariant(i.arg2) and invariant(i.arg3);
+        if (hoistable and may_trap(i) and not first)
+          hoistable = i.arg3.is_temp() and nonzero.count(i.arg3.get_temp()) > 0;
+        if (not hoistable) {
+          if (has_effects(i) or may_trap(i)) first = false;
+          continue;
+        }
+        // the value is now computed right before the header, out of the loop
+        defBlock[i.arg1.get_temp()] = h - 1;
+        f.hoist(pc, h);
+        ++moved;
+      }
+    }
+  }
+  return moved;
+}
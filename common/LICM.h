@@ -0,0 +1,50 @@
+/////////////////////////////////////////////////////////////////
+//
+//    LICM - Loop-invariant code motion
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+#include "code.h"
+#include "SSA.h"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class licm moves loop-invariant computations of a subroutine in SSA
+/// form to the preheader of their loop, so that they run once instead
+/// of on every iteration: arithmetic, comparisons, constant loads and
+/// loads of renamed variables and addresses (e.g. the base of an array
+/// parameter) whose operands are constants or defined out of the loop.
+///
+/// Loops are processed from the outermost, so a computation leaves
+/// all the loops it does not depend on. Memory reads stay in place.
+/// A division may trap, so it is hoisted only when its divisor is a
+/// nonzero constant, or when it is in the loop header before anything
+/// with a visible effect (then the loop would run it anyway, first).
+
+class licm {
+public:
+  /// hoist invariant computations. Returns the number of instructions moved
+  static size_t run(ssaForm &f);
+};
@@ -0,0 +1,65 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Optimizer - Passes over generated t-code
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+#include "Optimizer.h"
+#include "Inliner.h"
+#include "TailRecursion.h"
+#include "SSA.h"
+#include "SCCP.h"
+#include "DeadCode.h"
+#include "CopyPropagation.h"
+#include "ValueNumbering.h"
+#include "LICM.h"
+#include "StrengthReduction.h"
+#include "Peephole.h"
+#include "TempAllocator.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'optimizer'
+
+/// optimize all subroutines of the program
+void optimizer::run(code &c) {
+  // whole program first, while temporals are still fresh
+  inliner::run(c);
+  for (auto &s : c.get_subroutines()) run(s);
+}
+
+/// optimize one subroutine
+void optimizer::run(subroutine &s) {
+  tailRecursion::run(s);
+  ssaForm ssa(s);
+  sccp::run(ssa);
+  copyPropagation::run(ssa);
+  valueNumbering::run(ssa);
+  licm::run(ssa);
+  strengthReduction::run(ssa);
+  ssa.destruct();
+  deadCodeEliminator::run(s);
+  copyPropagation::coalesce(s);
+  // temporals last: earlier passes free many of them
+  tempAllocator::run(s);
+  // the allocator drops the copies left by the phis, leaving jumps to jumps
+  peephole::run(s);
+}
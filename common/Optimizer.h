@@ -0,0 +1,39 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Optimizer - Passes over generated t-code
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "code.h"
+
+
+////////////////////////////////////////////////////////////////////
+/// Class optimizer runs the t-code passes, in order, on every
+/// subroutine of a program produced by CodeGenVisitor
+
+class optimizer {
+public:
+  /// optimize all subroutines of the program
+  static void run(code &c);
+  /// optimize one subroutine
+  static void run(subroutine &s);
+};
@@ -0,0 +1,297 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Peephole - Local rewriting of jumps and branches
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "Peephole.h"
+
+using namespace std;
+
+/// the instruction only computes its result
+static bool pure(const instruction &i) {
+  switch (i.oper) {
+  case instruction::_ADD : case instruction::_SUB : case instruction::_MUL :
+  case instruction::_EQ : case instruction::_LT : case instruction::_LE :
+  case instruction::_NEG : case instruction::_NOT : case instruction::_AND : case instruction::_OR :
+  case instruction::_FLOAT :
+  case instruction::_FADD : case instruction::_FSUB : case instruction::_FMUL :
+  case instruction::_FEQ : case instruction::_FLT : case instruction::_FLE : case instruction::_FNEG :
+  case instruction::_LOAD : case instruction::_ILOAD : case instruction::_CHLOAD : case instruction::_FLOAD :
+  case instruction::_ALOAD : case instruction::_LOADX : case instruction::_LOADC :
+    return i.arg1.is_temp();
+  default :
+    // divisions may trap
+    return false;
+  }
+}
+
+/// compare-and-branch that jumps when the given one does not
+static instruction::Operation negated(instruction::Operation op) {
+  switch (op) {
+  case instruction::_IFEQ : return instruction::_IFNEQ;
+  case instruction::_IFNEQ : return instruction::_IFEQ;
+  case instruction::_IFLT : return instruction::_IFNLT;
+  case instruction::_IFNLT : return instruction::_IFLT;
+  case instruction::_IFLE : return instruction::_IFNLE;
+  case instruction::_IFNLE : return instruction::_IFLE;
+  case instruction::_IFFEQ : return instruction::_IFFNEQ;
+  case instruction::_IFFNEQ : return instruction::_IFFEQ;
+  case instruction::_IFFLT : return instruction::_IFFNLT;
+  case instruction::_IFFNLT : return instruction::_IFFLT;
+  case instruction::_IFFLE : return instruction::_IFFNLE;
+  case instruction::_IFFNLE : return instruction::_IFFLE;
+  default : return op;
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'peephole'
+
+const peephole::rule peephole::rules[] = {
+  &peephole::unreachable_code,
+  &peephole::dead_label,
+  &peephole::thread_jump,
+  &peephole::jump_to_return,
+  &peephole::jump_to_next,
+  &peephole::redundant_branch,
+  &peephole::double_not,
+  &peephole::invert_branch,
+};
+
+peephole::peephole(const subroutine &s) : ins(s.get_instructions()) {}
+
+/// rewrite the subroutine
+size_t peephole::run(subroutine &s) {
+  peephole p(s);
+  size_t total = 0, changes;
+  do {
+    p.index();
+    changes = 0;
+    for (size_t pc = 0; pc < p.ins.size(); ++pc)
+      for (rule r : rules)
+        if (p.ins[pc].oper != instruction::_NOOP and (p.*r)(pc)) ++changes;
+    total += changes;
+    vector<instruction> v;
+    v.reserve(p.ins.size());
+    for (auto &i : p.ins)
+      if (i.oper != instruction::_NOOP) v.push_back(i);
+    p.ins.swap(v);
+  } while (changes > 0);
+  if (total == 0) return 0;
+
+  s.set_instructions(p.ins);
+  return total;
+}
+
+/// compute labelPc and jumps
+void peephole::index() {
+  labelPc.clear();
+  jumps.clear();
+  for (size_t pc = 0; pc < ins.size(); ++pc) {
+    const instruction &i = ins[pc];
+    if (i.oper == instruction::_LABEL) labelPc[i.arg1.get_name_id()] = pc;
+    if (i.is_jump()) ++jumps[i.get_jump_label().get_name_id()];
+  }
+}
+
+/// check whether temporal 't' is written before being read on every
+/// path leaving the instruction at 'pc'
+bool peephole::dead_after(size_t pc, const operand &t) const {
+  vector<bool> seen(ins.size(), false);
+  vector<size_t> work;
+  auto successors = [&](size_t k) {
+    const instruction &i = ins[k];
+    if (i.oper == instruction::_RETURN) return;
+    if (i.is_jump()) work.push_back(labelPc.at(i.get_jump_label().get_name_id()));
+    if (i.oper != instruction::_UJUMP and k+1 < ins.size()) work.push_back(k+1);
+  };
+  successors(pc);
+  while (not work.empty()) {
+    size_t k = work.back();
+    work.pop_back();
+    if (seen[k]) continue;
+    seen[k] = true;
+    const instruction &i = ins[k];
+    for (int a = 1; a <= 3; ++a)
+      if (i.uses_arg(a) and i.get_arg(a) == t) return false;
+    if (not (i.defines_arg1() and i.arg1 == t)) successors(k);
+  }
+  return true;
+}
+
+/// previous/next instruction that is not a NOOP
+size_t peephole::prev(size_t pc) const {
+  while (pc-- > 0)
+    if (ins[pc].oper != instruction::_NOOP) return pc;
+  return ins.size();
+}
+size_t peephole::next(size_t pc) const {
+  while (++pc < ins.size())
+    if (ins[pc].oper != instruction::_NOOP) return pc;
+  return ins.size();
+}
+
+/// first instruction that is not a label executed after jumping to 'lab'
+size_t peephole::target(const operand &lab) const {
+  size_t pc = labelPc.at(lab.get_name_id());
+  while (pc < ins.size() and (ins[pc].oper == instruction::_LABEL or ins[pc].oper == instruction::_NOOP)) ++pc;
+  return pc;
+}
+
+/// turn the instruction into a NOOP, updating the counts
+void peephole::remove(size_t pc) {
+  instruction &i = ins[pc];
+  if (i.is_jump()) --jumps[i.get_jump_label().get_name_id()];
+  i = instruction::NOOP();
+}
+
+/// change the label of a jump
+void peephole::retarget(instruction &i, const operand &lab) {
+  --jumps[i.get_jump_label().get_name_id()];
+  ++jumps[lab.get_name_id()];
+  i.get_jump_label() = lab;
+}
+
+/// remove the definition of temporal 't' right before 'pc' if it is not used
+void peephole::remove_unused_def(size_t pc, const operand &t) {
+  if (not t.is_temp()) return;
+  size_t p = prev(pc);
+  if (p < ins.size() and pure(ins[p]) and ins[p].arg1 == t and dead_after(p, t)) remove(p);
+}
+
+/// a jump to a UJUMP goes to its target
+bool peephole::thread_jump(size_t pc) {
+  instruction &i = ins[pc];
+  if (not i.is_jump()) return false;
+  operand lab = i.get_jump_label();
+  // follow the chain (a loop of jumps ends it)
+  for (size_t hops = 0; hops < ins.size(); ++hops) {
+    size_t t = target(lab);
+    if (t == ins.size() or ins[t].oper != instruction::_UJUMP or ins[t].arg1 == lab) break;
+    lab = ins[t].arg1;
+  }
+  if (lab == i.get_jump_label()) return false;
+  retarget(i, lab);
+  return true;
+}
+
+/// a UJUMP to a RETURN returns
+bool peephole::jump_to_return(size_t pc) {
+  if (ins[pc].oper != instruction::_UJUMP) return false;
+  size_t t = target(ins[pc].arg1);
+  if (t == ins.size() or ins[t].oper != instruction::_RETURN) return false;
+  remove(pc);
+  ins[pc] = instruction::RETURN();
+  return true;
+}
+
+/// a jump to the next instruction does nothing
+bool peephole::jump_to_next(size_t pc) {
+  instruction &i = ins[pc];
+  if (not i.is_jump()) return false;
+  size_t l = labelPc[i.get_jump_label().get_name_id()];
+  if (l <= pc) return false;
+  for (size_t k = pc + 1; k < l; ++k)
+    if (ins[k].oper != instruction::_LABEL and ins[k].oper != instruction::_NOOP) return false;
+  operand cond = (i.oper == instruction::_FJUMP ? i.arg1 : operand());
+  remove(pc);
+  remove_unused_def(pc, cond);
+  return true;
+}
+
+/// "FJUMP c L; UJUMP L" (or a compare-and-branch to L) goes to L anyway
+bool peephole::redundant_branch(size_t pc) {
+  if (not ins[pc].is_jump() or ins[pc].oper == instruction::_UJUMP) return false;
+  size_t n = next(pc);
+  if (n == ins.size() or ins[n].oper != instruction::_UJUMP or ins[n].arg1 != ins[pc].get_jump_label()) return false;
+  operand cond = (ins[pc].oper == instruction::_FJUMP ? ins[pc].arg1 : operand());
+  remove(pc);
+  remove_unused_def(pc, cond);
+  return true;
+}
+
+/// "NOT t x; NOT c t; FJUMP c L" is "FJUMP x L" (t, c and x may be
+/// the same temporal, as the allocator leaves them)
+bool peephole::double_not(size_t pc) {
+  instruction &i = ins[pc];
+  if (i.oper != instruction::_FJUMP or not i.arg1.is_temp()) return false;
+  size_t p1 = prev(pc);
+  if (p1 == ins.size() or ins[p1].oper != instruction::_NOT or ins[p1].arg1 != i.arg1) return false;
+  operand t = ins[p1].arg2;
+  size_t p2 = prev(p1);
+  if (not t.is_temp() or p2 == ins.size() or ins[p2].oper != instruction::_NOT or ins[p2].arg1 != t) return false;
+  operand x = ins[p2].arg2;
+  if (not dead_after(pc, i.arg1) or (t != i.arg1 and not dead_after(p1, t))) return false;
+  remove(p1);
+  remove(p2);
+  i.arg1 = x;
+  return true;
+}
+
+/// "NOT c x; FJUMP c L1; UJUMP L2; L1:" is "FJUMP x L2; L1:", and
+/// "IFLT a b L1; UJUMP L2; L1:" is "IFNLT a b L2; L1:"
+bool peephole::invert_branch(size_t pc) {
+  instruction &i = ins[pc];
+  if (not i.is_compare_jump() and (i.oper != instruction::_FJUMP or not i.arg1.is_temp())) return false;
+  size_t n = next(pc);
+  if (n == ins.size() or ins[n].oper != instruction::_UJUMP) return false;
+  bool falls = false;
+  for (size_t k = next(n); k < ins.size() and ins[k].oper == instruction::_LABEL; k = next(k))
+    falls = falls or ins[k].arg1 == i.get_jump_label();
+  if (not falls) return false;
+  if (i.is_compare_jump()) {
+    operand lab = ins[n].arg1;
+    remove(n);
+    retarget(i, lab);
+    i.oper = negated(i.oper);
+    return true;
+  }
+  size_t p = prev(pc);
+  if (p == ins.size() or ins[p].oper != instruction::_NOT or ins[p].arg1 != i.arg1) return false;
+  if (not dead_after(pc, i.arg1)) return false;
+
+  operand x = ins[p].arg2, lab = ins[n].arg1;
+  remove(p);
+  remove(n);
+  retarget(i, lab);
+  i.arg1 = x;
+  return true;
+}
+
+/// code after a UJUMP or RETURN is not executed up to the next label
+bool peephole::unreachable_code(size_t pc) {
+  if (ins[pc].oper != instruction::_UJUMP and ins[pc].oper != instruction::_RETURN) return false;
+  bool changed = false;
+  for (size_t k = next(pc); k < ins.size() and ins[k].oper != instruction::_LABEL; k = next(k)) {
+    remove(k);
+    changed = true;
+  }
+  return changed;
+}
+
+/// a label no jump goes to
+bool peephole::dead_label(size_t pc) {
+  if (ins[pc].oper != instruction::_LABEL or jumps[ins[pc].arg1.get_name_id()] != 0) return false;
+  ins[pc] = instruction::NOOP();
+  return true;
+}
@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Peephole - Local rewriting of jumps and branches
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+#include "code.h"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class peephole rewrites short sequences of instructions of a
+/// subroutine, trying every rule of a table at each position and
+/// repeating until no rule applies:
+///
+///   - jump threading: a jump to a UJUMP goes to its target, and a
+///     UJUMP to a RETURN returns
+///   - a jump to the next instruction, or an FJUMP to the target of
+///     the UJUMP after it, is removed
+///   - branch inversion: "FJUMP c L1; UJUMP L2; L1:" is "FJUMP x L2"
+///     when c = NOT x, and an FJUMP on NOT NOT x tests x. A
+///     compare-and-branch is inverted with the opposite comparison
+///   - code after a UJUMP or RETURN up to the next label, and labels
+///     no jump goes to, are removed
+///
+/// A condition only used by a removed or inverted jump is removed when
+/// computed right before it.
+
+class peephole {
+private:
+  /// instructions being rewritten (NOOPs are dropped after each round)
+  std::vector<instruction> ins;
+  /// position of each label and number of jumps to it (by name id)
+  std::unordered_map<uint32_t, size_t> labelPc;
+  std::unordered_map<uint32_t, size_t> jumps;
+
+  /// a rule tries to rewrite the code at 'pc', and returns true if it did
+  typedef bool (peephole::*rule)(size_t pc);
+  static const rule rules[];
+
+  peephole(const subroutine &s);
+  /// compute labelPc and jumps
+  void index();
+  /// previous/next instruction that is not a NOOP (ins.size() if none)
+  size_t prev(size_t pc) const;
+  size_t next(size_t pc) const;
+  /// first instruction that is not a label executed after jumping to 'lab'
+  size_t target(const operand &lab) const;
+  /// turn the instruction into a NOOP, updating the counts
+  void remove(size_t pc);
+  /// change the label of a jump
+  void retarget(instruction &i, const operand &lab);
+  /// check whether temporal 't' is written before being read on every
+  /// path leaving the instruction at 'pc'
+  bool dead_after(size_t pc, const operand &t) const;
+  /// remove the definition of temporal 't' right before 'pc' if it is not used
+  void remove_unused_def(size_t pc, const operand &t);
+
+  bool thread_jump(size_t pc);
+  bool jump_to_return(size_t pc);
+  bool jump_to_next(size_t pc);
+  bool redundant_branch(size_t pc);
+  bool double_not(size_t pc);
+  bool invert_branch(size_t pc);
+  bool unreachable_code(size_t pc);
+  bool dead_label(size_t pc);
+
+public:
+  /// rewrite the subroutine. Returns the number of rewrites
+  static size_t run(subroutine &s);
+};
@@ -0,0 +1,345 @@
+/////////////////////////////////////////////////////////////////
+//
+//    SCCP - Sparse conditional constant propagation
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "SCCP.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'sccp'
+
+sccp::value::value(State s, const operand &o) : state(s), c(o) {}
+bool sccp::value::operator==(const value &o) const { return state == o.state and c == o.c; }
+bool sccp::value::operator!=(const value &o) const { return not (*this == o); }
+
+sccp::sccp(ssaForm &f) : ssa(f), cfg(f.get_cfg()), ins(f.get_instructions()) {
+  size_t nb = cfg.get_num_blocks();
+  uint32_t ntemps = 0;
+  auto see = [&](const operand &o) { if (o.is_temp()) ntemps = max(ntemps, o.get_temp() + 1); };
+  for (auto &i : ins)
+    for (int k = 1; k <= 3; ++k) see(i.get_arg(k));
+  for (size_t b = 0; b < nb; ++b)
+    for (auto &phi : ssa.get_phis(b)) {
+      see(phi.dest);
+      for (auto &a : phi.args) see(a);
+    }
+
+  // temporals not defined in reachable code have unknown values
+  vals.assign(ntemps, value(BOTTOM));
+  instrUses.resize(ntemps);
+  phiUses.resize(ntemps);
+  for (size_t b = 0; b < nb; ++b) {
+    if (not cfg.is_reachable(b)) continue;
+    auto &phis = ssa.get_phis(b);
+    for (size_t k = 0; k < phis.size(); ++k) {
+      vals[phis[k].dest.get_temp()] = value(TOP);
+      for (auto &a : phis[k].args)
+        if (a.is_temp()) phiUses[a.get_temp()].push_back(make_pair(b, k));
+    }
+    for (size_t pc = cfg.get_block(b).first; pc < cfg.get_block(b).last; ++pc) {
+      const instruction &i = ins[pc];
+      if (i.defines_arg1() and i.arg1.is_temp()) vals[i.arg1.get_temp()] = value(TOP);
+      for (int k = 1; k <= 3; ++k)
+        if (i.uses_arg(k) and i.get_arg(k).is_temp()) instrUses[i.get_arg(k).get_temp()].push_back(pc);
+    }
+  }
+
+  blockExec.assign(nb, false);
+  edgeExec.resize(nb);
+  for (size_t b = 0; b < nb; ++b) edgeExec[b].assign(cfg.get_block(b).preds.size(), false);
+}
+
+/// propagate constants in the subroutine
+size_t sccp::run(ssaForm &f) {
+  if (f.get_cfg().get_num_blocks() == 0) return 0;
+  sccp p(f);
+  p.solve();
+  return p.rewrite();
+}
+
+/// lattice meet: TOP is the identity and BOTTOM absorbs everything
+sccp::value sccp::meet(const value &a, const value &b) {
+  if (a.state == TOP) return b;
+  if (b.state == TOP) return a;
+  if (a == b) return a;
+  return value(BOTTOM);
+}
+
+/// value of an operand (names are never constant)
+sccp::value sccp::value_of(const operand &o) const {
+  if (o.is_temp()) return o.get_temp() < vals.size() ? vals[o.get_temp()] : value(BOTTOM);
+  if (o.is_const()) return value(CONST, o);
+  return value(BOTTOM);
+}
+
+/// whether tvm can load the constant with an immediate
+bool sccp::loadable(const operand &c) {
+  switch (c.get_kind()) {
+  case operand::_INTCONST : return c.get_int() >= 0;
+  case operand::_CHARCONST : return true;
+  case operand::_FLOATCONST : return std::isfinite(c.get_float()) and not std::signbit(c.get_float());
+  default : return false;
+  }
+}
+
+/// result of applying the operation to constant arguments ('b' is
+/// empty for unary operations). Integers wrap around as in tvm, and
+/// operations that would trap at run time are not folded
+operand sccp::fold(instruction::Operation op, const operand &a, const operand &b) {
+  bool ints = a.get_kind() == operand::_INTCONST and
+              (b.is_empty() or b.get_kind() == operand::_INTCONST);
+  bool floats = a.get_kind() == operand::_FLOATCONST and
+                (b.is_empty() or b.get_kind() == operand::_FLOATCONST);
+  bool chars = a.get_kind() == operand::_CHARCONST and b.get_kind() == operand::_CHARCONST;
+  int32_t x = ints ? a.get_int() : chars ? a.get_char() : 0;
+  int32_t y = ints and not b.is_empty() ? b.get_int() : chars ? b.get_char() : 0;
+  float f = floats ? a.get_float() : 0;
+  float g = floats and not b.is_empty() ? b.get_float() : 0;
+  switch (op) {
+  case instruction::_ADD : if (ints) return operand::INTCONST(int32_t(uint32_t(x) + uint32_t(y))); break;
+  case instruction::_SUB : if (ints) return operand::INTCONST(int32_t(uint32_t(x) - uint32_t(y))); break;
+  case instruction::_MUL : if (ints) return operand::INTCONST(int32_t(uint32_t(x) * uint32_t(y))); break;
+  case instruction::_DIV :
+    if (ints and y != 0 and not (x == INT_MIN and y == -1)) return operand::INTCONST(x / y);
+    break;
+  case instruction::_EQ : if (ints or chars) return operand::INTCONST(x == y); break;
+  case instruction::_LT : if (ints or chars) return operand::INTCONST(x < y); break;
+  case instruction::_LE : if (ints or chars) return operand::INTCONST(x <= y); break;
+  case instruction::_AND : if (ints) return operand::INTCONST(x != 0 and y != 0); break;
+  case instruction::_OR : if (ints) return operand::INTCONST(x != 0 or y != 0); break;
+  case instruction::_NEG : if (ints) return operand::INTCONST(int32_t(0u - uint32_t(x))); break;
+  case instruction::_NOT : if (ints) return operand::INTCONST(x == 0); break;
+  case instruction::_FLOAT : if (ints) return operand::FLOATCONST(float(x)); break;
+  case instruction::_FADD : if (floats) return operand::FLOATCONST(f + g); break;
+  case instruction::_FSUB : if (floats) return operand::FLOATCONST(f - g); break;
+  case instruction::_FMUL : if (floats) return operand::FLOATCONST(f * g); break;
+  case instruction::_FDIV : if (floats) return operand::FLOATCONST(f / g); break;
+  case instruction::_FNEG : if (floats) return operand::FLOATCONST(-f); break;
+  case instruction::_FEQ :
+    if (floats) return operand::INTCONST(f == g);
+    if (chars) return operand::INTCONST(x == y);
+    break;
+  case instruction::_FLT :
+    if (floats) return operand::INTCONST(f < g);
+    if (chars) return operand::INTCONST(x < y);
+    break;
+  case instruction::_FLE :
+    if (floats) return operand::INTCONST(f <= g);
+    if (chars) return operand::INTCONST(x <= y);
+    break;
+  default : break;
+  }
+  return operand();
+}
+
+/// value computed by an instruction, given the values of its arguments
+sccp::value sccp::evaluate(const instruction &i) const {
+  switch (i.oper) {
+  case instruction::_ILOAD :
+  case instruction::_FLOAD :
+  case instruction::_CHLOAD :
+    return value(CONST, i.arg2);
+  case instruction::_LOAD :
+    return value_of(i.arg2);
+  case instruction::_NEG : case instruction::_NOT : case instruction::_FNEG :
+  case instruction::_FLOAT :
+  case instruction::_ADD : case instruction::_SUB : case instruction::_MUL : case instruction::_DIV :
+  case instruction::_EQ : case instruction::_LT : case instruction::_LE :
+  case instruction::_AND : case instruction::_OR :
+  case instruction::_FADD : case instruction::_FSUB : case instruction::_FMUL : case instruction::_FDIV :
+  case instruction::_FEQ : case instruction::_FLT : case instruction::_FLE : {
+    value a = value_of(i.arg2);
+    value b = i.arg3.is_empty() ? value(CONST) : value_of(i.arg3);
+    if (a.state == BOTTOM or b.state == BOTTOM) return value(BOTTOM);
+    if (a.state == TOP or b.state == TOP) return value(TOP);
+    operand r = fold(i.oper, a.c, b.c);
+    return r.is_empty() ? value(BOTTOM) : value(CONST, r);
+  }
+  default :
+    // memory, calls and input
+    return value(BOTTOM);
+  }
+}
+
+/// whether a conditional jump is taken: the negated condition of an
+/// FJUMP, or the comparison of a compare-and-branch
+sccp::value sccp::taken(const instruction &jump) const {
+  instruction::Operation op = instruction::_NOT;
+  bool negated = false;
+  switch (jump.oper) {
+  case instruction::_FJUMP : break;
+  case instruction::_IFNEQ : negated = true; // fall through
+  case instruction::_IFEQ : op = instruction::_EQ; break;
+  case instruction::_IFNLT : negated = true; // fall through
+  case instruction::_IFLT : op = instruction::_LT; break;
+  case instruction::_IFNLE : negated = true; // fall through
+  case instruction::_IFLE : op = instruction::_LE; break;
+  case instruction::_IFFNEQ : negated = true; // fall through
+  case instruction::_IFFEQ : op = instruction::_FEQ; break;
+  case instruction::_IFFNLT : negated = true; // fall through
+  case instruction::_IFFLT : op = instruction::_FLT; break;
+  case instruction::_IFFNLE : negated = true; // fall through
+  case instruction::_IFFLE : op = instruction::_FLE; break;
+  default : return value(BOTTOM);
+  }
+  value v = evaluate(op == instruction::_NOT ? instruction(op, operand(), jump.arg1) :
+                                               instruction(op, operand(), jump.arg1, jump.arg2));
+  if (negated and v.state == CONST) v.c = operand::INTCONST(v.c.get_int() == 0);
+  return v;
+}
+
+/// lower the value of a temporal, and revisit its uses if it changed
+void sccp::lower(uint32_t t, const value &v) {
+  value m = meet(vals[t], v);
+  if (m == vals[t]) return;
+  vals[t] = m;
+  tempWork.push_back(t);
+}
+
+/// the edge can be taken: visit the block the first time, or merge
+/// the new incoming values into its phis
+void sccp::mark_edge(size_t from, size_t to) {
+  const vector<size_t> &preds = cfg.get_block(to).preds;
+  for (size_t k = 0; k < preds.size(); ++k) {
+    if (preds[k] != from or edgeExec[to][k]) continue;
+    edgeExec[to][k] = true;
+    if (not blockExec[to]) {
+      blockExec[to] = true;
+      blockWork.push_back(to);
+    }
+    else
+      for (size_t p = 0; p < ssa.get_phis(to).size(); ++p) visit_phi(to, p);
+  }
+}
+
+/// a phi merges the values coming through the executable edges
+void sccp::visit_phi(size_t b, size_t k) {
+  const phiNode &phi = ssa.get_phis(b)[k];
+  value v(TOP);
+  for (size_t e = 0; e < phi.args.size(); ++e)
+    if (edgeExec[b][e]) v = meet(v, value_of(phi.args[e]));
+  lower(phi.dest.get_temp(), v);
+}
+
+void sccp::visit_instruction(size_t pc) {
+  const instruction &i = ins[pc];
+  if (i.defines_arg1() and i.arg1.is_temp()) lower(i.arg1.get_temp(), evaluate(i));
+  else if (i.oper == instruction::_FJUMP or i.is_compare_jump()) visit_terminator(cfg.get_block_of(pc));
+}
+
+/// follow the edges leaving a block that can be taken
+void sccp::visit_terminator(size_t b) {
+  const basicBlock &bb = cfg.get_block(b);
+  const instruction &last = ins[bb.last - 1];
+  if (last.oper == instruction::_FJUMP or last.is_compare_jump()) {
+    value c = taken(last);
+    if (c.state == TOP) return;
+    bool known = c.state == CONST and c.c.get_kind() == operand::_INTCONST;
+    if ((not known or c.c.get_int() != 0) and cfg.get_jump_target(b) != CFG::NONE)
+      mark_edge(b, cfg.get_jump_target(b));
+    if ((not known or c.c.get_int() == 0) and b + 1 < cfg.get_num_blocks()) mark_edge(b, b + 1);
+    return;
+  }
+  for (size_t s : bb.succs) mark_edge(b, s);
+}
+
+void sccp::solve() {
+  blockExec[0] = true;
+  blockWork.push_back(0);
+  while (not blockWork.empty() or not tempWork.empty()) {
+    if (not blockWork.empty()) {
+      size_t b = blockWork.back();
+      blockWork.pop_back();
+      for (size_t k = 0; k < ssa.get_phis(b).size(); ++k) visit_phi(b, k);
+      const basicBlock &bb = cfg.get_block(b);
+      for (size_t pc = bb.first; pc < bb.last; ++pc)
+        if (ins[pc].oper != instruction::_FJUMP and not ins[pc].is_compare_jump()) visit_instruction(pc);
+      visit_terminator(b);
+      continue;
+    }
+    uint32_t t = tempWork.back();
+    tempWork.pop_back();
+    for (auto &u : phiUses[t])
+      if (blockExec[u.first]) visit_phi(u.first, u.second);
+    for (size_t pc : instrUses[t])
+      if (blockExec[cfg.get_block_of(pc)]) visit_instruction(pc);
+  }
+}
+
+/// rewrite the code with the values found
+size_t sccp::rewrite() {
+  size_t changes = 0;
+  for (size_t b = 0; b < cfg.get_num_blocks(); ++b) {
+    const basicBlock &bb = cfg.get_block(b);
+    if (not blockExec[b]) {
+      for (size_t pc = bb.first; pc < bb.last; ++pc) {
+        if (ins[pc].oper == instruction::_LABEL or ins[pc].oper == instruction::_NOOP) continue;
+        ins[pc] = instruction::NOOP();
+        ++changes;
+      }
+      for (auto &phi : ssa.get_phis(b))
+        for (auto &a : phi.args) a = operand();
+      continue;
+    }
+
+    // phis: no copies on edges that are never taken, and constants
+    // instead of the temporals that hold them
+    for (auto &phi : ssa.get_phis(b)) {
+      value v = value_of(phi.dest);
+      for (size_t e = 0; e < phi.args.size(); ++e) {
+        operand a = not edgeExec[b][e] ? operand() :
+                    (v.state == CONST and loadable(v.c)) ? v.c : phi.args[e];
+        if (a == phi.args[e]) continue;
+        phi.args[e] = a;
+        ++changes;
+      }
+    }
+
+    for (size_t pc = bb.first; pc < bb.last; ++pc) {
+      instruction &i = ins[pc];
+      if (i.oper == instruction::_FJUMP or i.is_compare_jump()) {
+        value c = taken(i);
+        if (c.state != CONST or c.c.get_kind() != operand::_INTCONST) continue;
+        if (c.c.get_int() != 0) i = instruction::UJUMP(i.get_jump_label().get_name());
+        else i = instruction::NOOP();
+        ++changes;
+        continue;
+      }
+      if (not i.defines_arg1() or not i.arg1.is_temp()) continue;
+      value v = vals[i.arg1.get_temp()];
+      if (v.state != CONST or not loadable(v.c)) continue;
+      instruction::Operation op = (v.c.get_kind() == operand::_INTCONST ? instruction::_ILOAD :
+                                   v.c.get_kind() == operand::_FLOATCONST ? instruction::_FLOAD :
+                                   instruction::_CHLOAD);
+      if (i.oper == op and i.arg2 == v.c) continue;
+      i = instruction(op, i.arg1, v.c);
+      ++changes;
+    }
+  }
+  return changes;
+}
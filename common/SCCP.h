@@ -0,0 +1,106 @@
+/////////////////////////////////////////////////////////////////
+//
+//    SCCP - Sparse conditional constant propagation
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "code.h"
+#include "CFG.h"
+#include "SSA.h"
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class sccp does sparse conditional constant propagation (Wegman &
+/// Zadeck) on a subroutine in SSA form. Each SSA value starts unknown
+/// (TOP) and only goes down to a constant or to BOTTOM (not constant),
+/// while only the CFG edges that can be taken given the values known so
+/// far are followed. This finds constants that flow around loops and
+/// through branches whose conditions are constant, which a pass that
+/// folds first and prunes later would miss.
+///
+/// Afterwards, definitions with a constant value become loads of the
+/// constant (ILOAD/FLOAD/CHLOAD), jumps on constant conditions become
+/// unconditional or disappear, and blocks that can not be reached are
+/// emptied (their labels are kept). tvm has no negative immediates, so
+/// negative and non-finite constants are propagated but not loaded.
+
+class sccp {
+private:
+  typedef enum {TOP, CONST, BOTTOM} State;
+  /// lattice value of an SSA value
+  class value {
+  public:
+    State state;
+    operand c;
+    value(State s = TOP, const operand &o = operand());
+    bool operator==(const value &o) const;
+    bool operator!=(const value &o) const;
+  };
+
+  ssaForm &ssa;
+  const CFG &cfg;
+  std::vector<instruction> &ins;
+  /// value of each temporal (by number)
+  std::vector<value> vals;
+  /// instructions (by pc) and phis (block, index) reading each temporal
+  std::vector<std::vector<size_t>> instrUses;
+  std::vector<std::vector<std::pair<size_t, size_t>>> phiUses;
+  /// executable blocks, and executable incoming edges of each block
+  /// (in the order of basicBlock::preds)
+  std::vector<bool> blockExec;
+  std::vector<std::vector<bool>> edgeExec;
+  /// pending blocks (to visit for the first time) and lowered temporals
+  std::vector<size_t> blockWork;
+  std::vector<uint32_t> tempWork;
+
+  sccp(ssaForm &f);
+  /// lattice meet
+  static value meet(const value &a, const value &b);
+  /// value of an operand (names are never constant)
+  value value_of(const operand &o) const;
+  /// value computed by an instruction, given the values of its arguments
+  value evaluate(const instruction &i) const;
+  /// whether a conditional jump (FJUMP or compare-and-branch) is taken
+  value taken(const instruction &jump) const;
+  /// result of applying the operation to constant arguments (empty if
+  /// it is not known at compile time)
+  static operand fold(instruction::Operation op, const operand &a, const operand &b);
+  /// whether tvm can load the constant with an immediate
+  static bool loadable(const operand &c);
+
+  void lower(uint32_t t, const value &v);
+  void mark_edge(size_t from, size_t to);
+  void visit_phi(size_t b, size_t k);
+  void visit_instruction(size_t pc);
+  void visit_terminator(size_t b);
+  void solve();
+  size_t rewrite();
+
+public:
+  /// propagate constants in the subroutine. Returns the number of
+  /// instructions and phi arguments rewritten
+  static size_t run(ssaForm &f);
+};
@@ -0,0 +1,394 @@
+/////////////////////////////////////////////////////////////////
+//
+//    SSA - Static single assignment form of a subroutine
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+#include "SSA.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// copy 'src' into 'dest'
+static instruction copy_instr(const operand &dest, const operand &src) {
+  switch (src.get_kind()) {
+  case operand::_INTCONST : return instruction(instruction::_ILOAD, dest, src);
+  case operand::_FLOATCONST : return instruction(instruction::_FLOAD, dest, src);
+  case operand::_CHARCONST : return instruction(instruction::_CHLOAD, dest, src);
+  default : return instruction::LOAD(dest, src);
+  }
+}
+
+/// the entry block must not be the target of a jump, since its phis
+/// would have no incoming value for the entry: add a NOOP in front of
+/// a leading label (destruct removes it)
+static subroutine & with_entry_block(subroutine &s) {
+  const vector<instruction> &ins = s.get_instructions();
+  if (ins.empty() or ins[0].oper != instruction::_LABEL) return s;
+  vector<instruction> v;
+  v.reserve(ins.size() + 1);
+  v.push_back(instruction::NOOP());
+  v.insert(v.end(), ins.begin(), ins.end());
+  s.set_instructions(v);
+  return s;
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'ssaForm'
+
+/// convert the subroutine to SSA form
+ssaForm::ssaForm(subroutine &s) : sub(s), cfg(with_entry_block(s)), ins(s.get_instructions()),
+                                  phis(cfg.get_num_blocks()), nextTemp(1),
+                                  preheader(cfg.get_num_blocks()), after(ins.size()) {
+  for (auto &i : ins)
+    for (int k = 1; k <= 3; ++k)
+      if (i.get_arg(k).is_temp()) nextTemp = max(nextTemp, i.get_arg(k).get_temp() + 1);
+
+  liveness lv(cfg);
+  const varIndex &vars = lv.get_vars();
+  operand result = operand::NAME("_result");
+  vector<bool> renamed(vars.size());
+  for (size_t v = 0; v < vars.size(); ++v) {
+    renamed[v] = not vars.is_memory(v) and vars.get_operand(v) != result;
+    if (renamed[v] and vars.get_operand(v).is_name()) renamedNames.insert(vars.get_operand(v).get_name_id());
+  }
+
+  place_phis(lv, renamed);
+  rename(vars, renamed);
+}
+
+/// place phis at the iterated dominance frontier of the definitions of
+/// each variable, where the variable is live
+void ssaForm::place_phis(const liveness &lv, const vector<bool> &renamed) {
+  const varIndex &vars = lv.get_vars();
+  size_t nb = cfg.get_num_blocks(), nv = vars.size();
+
+  // dominance frontiers (Cooper, Harvey & Kennedy)
+  vector<vector<size_t>> df(nb);
+  for (size_t b = 0; b < nb; ++b) {
+    if (not cfg.is_reachable(b)) continue;
+    const vector<size_t> &preds = cfg.get_block(b).preds;
+    if (preds.size() < 2) continue;
+    for (size_t p : preds) {
+      for (size_t r = p; r != cfg.get_idom(b) and r != CFG::NONE and cfg.is_reachable(r); r = cfg.get_idom(r)) {
+        if (not df[r].empty() and df[r].back() == b) break;
+        df[r].push_back(b);
+      }
+    }
+  }
+
+  // blocks defining each variable
+  vector<vector<size_t>> defBlocks(nv);
+  for (size_t b = 0; b < nb; ++b) {
+    if (not cfg.is_reachable(b)) continue;
+    for (size_t pc = cfg.get_block(b).first; pc < cfg.get_block(b).last; ++pc) {
+      if (not ins[pc].defines_arg1()) continue;
+      size_t v = vars.get_index(ins[pc].arg1);
+      if (renamed[v] and (defBlocks[v].empty() or defBlocks[v].back() != b)) defBlocks[v].push_back(b);
+    }
+  }
+
+  vector<size_t> hasPhi(nb, CFG::NONE), queued(nb, CFG::NONE);
+  vector<size_t> work;
+  for (size_t v = 0; v < nv; ++v) {
+    if (defBlocks[v].empty()) continue;
+    work = defBlocks[v];
+    for (size_t b : work) queued[b] = v;
+    while (not work.empty()) {
+      size_t x = work.back();
+      work.pop_back();
+      for (size_t y : df[x]) {
+        if (hasPhi[y] == v or not lv.get_in(y).test(v)) continue;
+        hasPhi[y] = v;
+        phiNode phi;
+        phi.var = phi.dest = vars.get_operand(v);
+        phi.args.assign(cfg.get_block(y).preds.size(), phi.var);
+        phis[y].push_back(phi);
+        if (queued[y] != v) {
+          queued[y] = v;
+          work.push_back(y);
+        }
+      }
+    }
+  }
+}
+
+/// give a new name to each definition, walking the dominator tree
+void ssaForm::rename(const varIndex &vars, const vector<bool> &renamed) {
+  size_t nv = vars.size();
+  if (cfg.get_num_blocks() == 0) return;
+
+  // temporals defined once are already in SSA form: keep their names
+  vector<size_t> ndefs(nv, 0);
+  for (auto &i : ins)
+    if (i.defines_arg1()) ++ndefs[vars.get_index(i.arg1)];
+
+  // current version of each variable (empty: the original name)
+  vector<vector<operand>> version(nv);
+  vector<size_t> pushed;
+  auto top = [&](size_t v) -> const operand & {
+    return version[v].empty() ? vars.get_operand(v) : version[v].back();
+  };
+  auto push = [&](size_t v, const operand &o) {
+    version[v].push_back(o);
+    pushed.push_back(v);
+  };
+
+  // (block, next child, size of 'pushed' when entering the block)
+  struct frame { size_t b, child, mark; };
+  vector<frame> stack;
+  stack.push_back(frame{0, 0, 0});
+  bool entering = true;
+  while (not stack.empty()) {
+    frame &f = stack.back();
+    const basicBlock &bb = cfg.get_block(f.b);
+    if (entering) {
+      f.mark = pushed.size();
+      for (auto &phi : phis[f.b]) {
+        phi.dest = new_temp();
+        push(vars.get_index(phi.var), phi.dest);
+      }
+      for (size_t pc = bb.first; pc < bb.last; ++pc) {
+        instruction &i = ins[pc];
+        for (int k = 1; k <= 3; ++k) {
+          if (not i.uses_arg(k)) continue;
+          size_t v = vars.get_index(i.get_arg(k));
+          if (renamed[v]) i.get_arg(k) = top(v);
+        }
+        if (i.defines_arg1()) {
+          size_t v = vars.get_index(i.arg1);
+          if (not renamed[v]) continue;
+          if (not (i.arg1.is_temp() and ndefs[v] == 1)) i.arg1 = new_temp();
+          push(v, i.arg1);
+        }
+      }
+      for (size_t s : bb.succs) {
+        const vector<size_t> &preds = cfg.get_block(s).preds;
+        size_t k = find(preds.begin(), preds.end(), f.b) - preds.begin();
+        for (auto &phi : phis[s]) phi.args[k] = top(vars.get_index(phi.var));
+      }
+    }
+    if (f.child < bb.dom_children.size()) {
+      size_t c = bb.dom_children[f.child++];
+      stack.push_back(frame{c, 0, 0});
+      entering = true;
+    }
+    else {
+      while (pushed.size() > f.mark) {
+        version[pushed.back()].pop_back();
+        pushed.pop_back();
+      }
+      stack.pop_back();
+      entering = false;
+    }
+  }
+}
+
+/// subroutine being transformed
+const subroutine & ssaForm::get_subroutine() const { return sub; }
+/// block structure
+const CFG & ssaForm::get_cfg() const { return cfg; }
+/// instructions in SSA form
+vector<instruction> & ssaForm::get_instructions() { return ins; }
+/// phi nodes of a block
+vector<phiNode> & ssaForm::get_phis(size_t b) { return phis[b]; }
+/// new temporal
+operand ssaForm::new_temp() { return operand::TEMP(nextTemp++); }
+/// renamed variables keep their value on entry
+bool ssaForm::is_renamed(const operand &o) const {
+  return o.is_name() and renamedNames.count(o.get_name_id()) > 0;
+}
+
+/// check whether loop header 'h' can get a preheader
+bool ssaForm::has_preheader(size_t h) const {
+  if (h == 0 or not cfg.is_reachable(h) or not cfg.is_reachable(h-1)) return false;
+  size_t p = h - 1;
+  const instruction &last = ins[cfg.get_block(p).last - 1];
+  // the preheader code goes right before the header: p must fall
+  // through into it (and not also jump to it), and not be in the loop
+  if (last.oper == instruction::_UJUMP or last.oper == instruction::_RETURN) return false;
+  if ((last.oper == instruction::_FJUMP or last.is_compare_jump()) and
+      block_of_label(last.get_jump_label()) == h) return false;
+  if (cfg.dominates(h, p)) return false;
+  for (size_t q : cfg.get_block(h).preds)
+    if (q != p and cfg.is_reachable(q) and has_edge(q, h) and not cfg.dominates(h, q)) return false;
+  return true;
+}
+
+/// code of the preheader of loop header 'h'
+vector<instruction> & ssaForm::get_preheader(size_t h) { return preheader[h]; }
+
+/// move an instruction to the preheader of loop header 'h'
+void ssaForm::hoist(size_t pc, size_t h) {
+  preheader[h].push_back(ins[pc]);
+  ins[pc] = instruction::NOOP();
+}
+
+/// add an instruction after the one at 'pc'
+void ssaForm::insert_after(size_t pc, const instruction &i) { after[pc].push_back(i); }
+
+/// block starting at given label
+size_t ssaForm::block_of_label(const operand &lab) const { return cfg.get_block_of(sub.get_label_pc(lab)); }
+
+/// check whether the (possibly edited) code still goes from block p to block b
+bool ssaForm::has_edge(size_t p, size_t b) const {
+  const instruction &last = ins[cfg.get_block(p).last - 1];
+  switch (last.oper) {
+  case instruction::_UJUMP : return block_of_label(last.arg1) == b;
+  case instruction::_FJUMP : return block_of_label(last.arg2) == b or b == p + 1;
+  case instruction::_RETURN : return false;
+  default :
+    if (last.is_compare_jump()) return block_of_label(last.arg3) == b or b == p + 1;
+    return b == p + 1;
+  }
+}
+
+/// append copies for the parallel assignment dests[i] = srcs[i]
+void ssaForm::sequentialize(vector<operand> dests, vector<operand> srcs, vector<instruction> &out) {
+  for (size_t i = 0; i < dests.size(); ) {
+    if (dests[i] == srcs[i] or srcs[i].is_empty()) {
+      dests.erase(dests.begin() + i);
+      srcs.erase(srcs.begin() + i);
+    }
+    else ++i;
+  }
+  while (not dests.empty()) {
+    // a copy whose destination no other pending copy reads can go now
+    size_t i = 0;
+    for (; i < dests.size(); ++i) {
+      bool read = false;
+      for (size_t j = 0; j < srcs.size() and not read; ++j)
+        read = (j != i and srcs[j] == dests[i]);
+      if (not read) break;
+    }
+    if (i < dests.size()) {
+      out.push_back(copy_instr(dests[i], srcs[i]));
+      dests.erase(dests.begin() + i);
+      srcs.erase(srcs.begin() + i);
+    }
+    else {
+      // only cycles remain: save one destination and read the copy instead
+      operand t = new_temp();
+      out.push_back(copy_instr(t, dests[0]));
+      for (auto &s : srcs)
+        if (s == dests[0]) s = t;
+    }
+  }
+}
+
+/// replace phis by copies and write the code back to the subroutine
+void ssaForm::destruct() {
+  size_t n = ins.size();
+  // copies to insert before each instruction, and split blocks to append
+  vector<vector<instruction>> before(n + 1);
+  vector<instruction> tail;
+  // jumps to retarget to split blocks: (pc of FJUMP or compare-and-branch, new label)
+  vector<pair<size_t, operand>> retarget;
+  // split blocks made so far (to name them)
+  size_t splits = 0;
+
+  // preheaders, before the copies of the phis of the header
+  for (size_t b = 0; b < cfg.get_num_blocks(); ++b)
+    before[cfg.get_block(b).first] = preheader[b];
+
+  for (size_t b = 0; b < cfg.get_num_blocks(); ++b) {
+    if (phis[b].empty() or not cfg.is_reachable(b)) continue;
+    const vector<size_t> &preds = cfg.get_block(b).preds;
+    for (size_t k = 0; k < preds.size(); ++k) {
+      size_t p = preds[k];
+      if (not cfg.is_reachable(p) or not has_edge(p, b)) continue;
+      vector<operand> dests, srcs;
+      for (auto &phi : phis[b]) {
+        dests.push_back(phi.dest);
+        srcs.push_back(phi.args[k]);
+      }
+      vector<instruction> copies;
+      sequentialize(dests, srcs, copies);
+      if (copies.empty()) continue;
+
+      size_t last = cfg.get_block(p).last - 1;
+      const instruction &j = ins[last];
+      if (j.oper == instruction::_UJUMP)
+        before[last].insert(before[last].end(), copies.begin(), copies.end());
+      else if (j.oper != instruction::_FJUMP and not j.is_compare_jump())
+        before[last+1].insert(before[last+1].end(), copies.begin(), copies.end());
+      else {
+        // critical edges: the fall-through path gets the copies right
+        // after the jump, the jump goes to a new block with the copies
+        if (b == p + 1)
+          before[last+1].insert(before[last+1].end(), copies.begin(), copies.end());
+        if (block_of_label(j.get_jump_label()) == b) {
+          string name;
+          do name = "split" + to_string(++splits) + "_" + to_string(b);
+          while (sub.has_label(operand::LABEL(name)));
+          tail.push_back(instruction::LABEL(name));
+          tail.insert(tail.end(), copies.begin(), copies.end());
+          tail.push_back(instruction::UJUMP(j.get_jump_label().get_name()));
+          retarget.push_back(make_pair(last, operand::LABEL(name)));
+        }
+      }
+    }
+  }
+  for (auto &r : retarget) ins[r.first].get_jump_label() = r.second;
+
+  vector<instruction> out;
+  out.reserve(n + tail.size());
+  for (size_t pc = 0; pc <= n; ++pc) {
+    out.insert(out.end(), before[pc].begin(), before[pc].end());
+    if (pc == n) continue;
+    if (ins[pc].oper != instruction::_NOOP) out.push_back(ins[pc]);
+    out.insert(out.end(), after[pc].begin(), after[pc].end());
+  }
+  if (not tail.empty()) {
+    if (out.empty() or (out.back().oper != instruction::_UJUMP and out.back().oper != instruction::_RETURN))
+      out.push_back(instruction::RETURN());
+    out.insert(out.end(), tail.begin(), tail.end());
+  }
+
+  sub.set_instructions(out);
+}
+
+/// print instructions and phis (for debugging)
+void ssaForm::dump(ostream &os) const {
+  os << "ssa " << sub.get_name() << "\n";
+  for (size_t b = 0; b < cfg.get_num_blocks(); ++b) {
+    for (auto &i : preheader[b]) {
+      os << "   (preheader) ";
+      i.dump(os);
+      os << "\n";
+    }
+    os << "B" << b << ":\n";
+    for (auto &phi : phis[b]) {
+      os << "   " << phi.dest << " = phi(";
+      for (size_t k = 0; k < phi.args.size(); ++k) os << (k ? ", " : "") << phi.args[k];
+      os << ")\n";
+    }
+    for (size_t pc = cfg.get_block(b).first; pc < cfg.get_block(b).last; ++pc) {
+      ins[pc].dump(os);
+      os << "\n";
+      for (auto &i : after[pc]) {
+        i.dump(os);
+        os << "\n";
+      }
+    }
+  }
+}
@@ -0,0 +1,135 @@
+/////////////////////////////////////////////////////////////////
+//
+//    SSA - Static single assignment form of a subroutine
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "code.h"
+#include "CFG.h"
+#include "Dataflow.h"
+
+#include <vector>
+#include <unordered_set>
+#include <ostream>
+#include <cstdint>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class phiNode merges the versions of a variable reaching a block:
+/// 'dest' takes args[k] when control comes from the k-th predecessor
+/// of the block (in the order of basicBlock::preds)
+
+class phiNode {
+public:
+  /// variable before renaming
+  operand var;
+  operand dest;
+  std::vector<operand> args;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class ssaForm converts a subroutine to SSA form and back.
+///
+/// Construction places (pruned) phi nodes at the iterated dominance
+/// frontiers of the definitions, and renames every definition of a
+/// temporal or scalar variable to a fresh temporal. The value a
+/// variable has on entry keeps its original name. Variables that live
+/// in memory (arrays, address-taken variables, see varIndex) and
+/// '_result' are not renamed: stores through XLOAD/CLOAD and calls may
+/// change them behind our back.
+///
+/// While in SSA form, passes may edit the instructions and phis in
+/// place as long as they keep positions and labels: replace operands,
+/// turn instructions into NOOPs, or turn an FJUMP into a UJUMP or NOOP.
+/// The block structure of get_cfg() stays valid meanwhile. They may
+/// also add code to the preheader of a loop (code that runs on the
+/// edges entering the loop header), or right after an instruction.
+///
+/// Destruction replaces the phis by copies on the incoming edges that
+/// still exist, splitting critical edges, and writes the code back to
+/// the subroutine. The copies on an edge are a parallel assignment;
+/// they are sequentialized so that each one is done once, with an
+/// extra temporal only to break cycles.
+
+class ssaForm {
+private:
+  subroutine &sub;
+  CFG cfg;
+  /// renamed instructions
+  std::vector<instruction> ins;
+  /// phi nodes at the start of each block
+  std::vector<std::vector<phiNode>> phis;
+  /// next free temporal number
+  uint32_t nextTemp;
+  /// names (ids) of the renamed variables
+  std::unordered_set<uint32_t> renamedNames;
+  /// instructions added in front of each loop header, and after each instruction
+  std::vector<std::vector<instruction>> preheader;
+  std::vector<std::vector<instruction>> after;
+
+  void place_phis(const liveness &lv, const std::vector<bool> &renamed);
+  void rename(const varIndex &vars, const std::vector<bool> &renamed);
+  /// check whether the (possibly edited) code still goes from block p to block b
+  bool has_edge(size_t p, size_t b) const;
+  /// block starting at given label
+  size_t block_of_label(const operand &lab) const;
+  /// append copies for the parallel assignment dests[i] = srcs[i]
+  void sequentialize(std::vector<operand> dests, std::vector<operand> srcs,
+                     std::vector<instruction> &out);
+
+public:
+  /// convert the subroutine to SSA form
+  ssaForm(subroutine &s);
+
+  /// subroutine being transformed (its instructions are not in SSA form)
+  const subroutine & get_subroutine() const;
+  /// block structure (of the code when it was converted)
+  const CFG & get_cfg() const;
+  /// instructions in SSA form
+  std::vector<instruction> & get_instructions();
+  /// phi nodes of a block
+  std::vector<phiNode> & get_phis(size_t b);
+  /// new temporal, not used anywhere in the subroutine
+  operand new_temp();
+  /// true for the names of renamed variables: in SSA form they are
+  /// never written, so they keep their value on entry (e.g. a parameter)
+  bool is_renamed(const operand &o) const;
+
+  /// check whether loop header 'h' can get a preheader: it is entered
+  /// only falling through from the previous block (as while loops are)
+  bool has_preheader(size_t h) const;
+  /// code of the preheader of loop header 'h' (see has_preheader). Its
+  /// operands must be available at the end of block h-1
+  std::vector<instruction> & get_preheader(size_t h);
+  /// move the instruction at 'pc' (leaving a NOOP) to the end of the
+  /// preheader of loop header 'h'
+  void hoist(size_t pc, size_t h);
+  /// add an instruction after the one at 'pc' (which must not be a jump)
+  void insert_after(size_t pc, const instruction &i);
+
+  /// replace phis by copies and write the code back to the subroutine
+  void destruct();
+
+  /// print instructions and phis (for debugging)
+  void dump(std::ostream &os) const;
+};
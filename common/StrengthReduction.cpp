@@ -0,0 +1,338 @@
+/////////////////////////////////////////////////////////////////
+//
+//    StrengthReduction - Induction variables and cheaper arithmetic
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "StrengthReduction.h"
+#include "CFG.h"
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+  /// basic induction variable: phi in the loop header and its update
+  class inductionVar {
+  public:
+    operand var;
+    size_t updatePc;
+    operand step;
+    bool down;
+  };
+  /// induction variable q = p * k made for a product
+  class derivedVar {
+  public:
+    operand base, factor, var;
+    int32_t value;
+    bool known;
+  };
+}
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'strengthReduction'
+
+/// reduce the subroutine
+size_t strengthReduction::run(ssaForm &f) {
+  const CFG &cfg = f.get_cfg();
+  vector<instruction> &ins = f.get_instructions();
+  size_t nb = cfg.get_num_blocks();
+  if (nb == 0) return 0;
+
+  // block and instruction defining each temporal, and integer constants
+  unordered_map<uint32_t, size_t> defBlock, defPc;
+  unordered_map<uint32_t, int32_t> intValue;
+  auto record = [&](const instruction &i, size_t b) {
+    if (not i.defines_arg1() or not i.arg1.is_temp()) return;
+    defBlock[i.arg1.get_temp()] = b;
+    if (i.oper == instruction::_ILOAD) intValue[i.arg1.get_temp()] = i.arg2.get_int();
+  };
+  for (size_t b = 0; b < nb; ++b) {
+    if (not cfg.is_reachable(b)) continue;
+    for (auto &i : f.get_preheader(b)) record(i, b-1);
+    for (auto &phi : f.get_phis(b)) defBlock[phi.dest.get_temp()] = b;
+    for (size_t pc = cfg.get_block(b).first; pc < cfg.get_block(b).last; ++pc) {
+      record(ins[pc], b);
+      if (ins[pc].defines_arg1() and ins[pc].arg1.is_temp()) defPc[ins[pc].arg1.get_temp()] = pc;
+    }
+  }
+  auto known = [&](const operand &o, int32_t &v) {
+    if (o.get_kind() == operand::_INTCONST) { v = o.get_int(); return true; }
+    if (not o.is_temp()) return false;
+    auto p = intValue.find(o.get_temp());
+    if (p == intValue.end()) return false;
+    v = p->second;
+    return true;
+  };
+
+  // temporals whose value is held by another operand
+  unordered_map<uint32_t, operand> same;
+  auto replace = [&](operand &o) {
+    while (o.is_temp()) {
+      auto p = same.find(o.get_temp());
+      if (p == same.end()) return;
+      o = p->second;
+    }
+  };
+  auto replace_all = [&]() {
+    for (size_t b = 0; b < nb; ++b) {
+      for (auto &i : f.get_preheader(b))
+        for (int k = 1; k <= 3; ++k)
+          if (i.uses_arg(k)) replace(i.get_arg(k));
+      for (auto &phi : f.get_phis(b))
+        for (auto &a : phi.args) replace(a);
+    }
+    for (auto &i : ins)
+      for (int k = 1; k <= 3; ++k)
+        if (i.uses_arg(k)) replace(i.get_arg(k));
+  };
+
+  size_t reduced = 0;
+  auto rewrite = [&](instruction &i, const instruction &by) {
+    if (by.oper == instruction::_ILOAD) intValue[i.arg1.get_temp()] = by.arg2.get_int();
+    i = by;
+    ++reduced;
+  };
+  // operations that need no computation
+  for (size_t pc = 0; pc < ins.size(); ++pc) {
+    instruction &i = ins[pc];
+    if (not i.defines_arg1() or not i.arg1.is_temp()) continue;
+    int32_t a = 0, b = 0;
+    bool ka = known(i.arg2, a), kb = known(i.arg3, b);
+    instruction zero(instruction::_ILOAD, i.arg1, operand::INTCONST(0));
+    if (i.oper == instruction::_MUL and ((ka and a == 0) or (kb and b == 0)))
+      rewrite(i, zero);
+    else if (i.oper == instruction::_SUB and i.arg2.is_temp() and i.arg2 == i.arg3)
+      rewrite(i, zero);
+    else if ((((i.oper == instruction::_MUL or i.oper == instruction::_DIV) and kb and b == 1) or
+              ((i.oper == instruction::_ADD or i.oper == instruction::_SUB) and kb and b == 0)) and
+             i.arg2.is_temp()) {
+      same[i.arg1.get_temp()] = i.arg2;
+      rewrite(i, instruction::NOOP());
+    }
+    else if (((i.oper == instruction::_MUL and ka and a == 1) or (i.oper == instruction::_ADD and ka and a == 0)) and
+             i.arg3.is_temp()) {
+      same[i.arg1.get_temp()] = i.arg3;
+      rewrite(i, instruction::NOOP());
+    }
+  }
+  if (not same.empty()) replace_all();
+
+  // uses of each temporal
+  unordered_map<uint32_t, size_t> uses;
+  auto count = [&](const instruction &i) {
+    for (int k = 1; k <= 3; ++k)
+      if (i.uses_arg(k) and i.get_arg(k).is_temp()) ++uses[i.get_arg(k).get_temp()];
+  };
+  for (size_t b = 0; b < nb; ++b) {
+    for (auto &i : f.get_preheader(b)) count(i);
+    for (auto &phi : f.get_phis(b))
+      for (auto &a : phi.args)
+        if (a.is_temp()) ++uses[a.get_temp()];
+  }
+  for (auto &i : ins) count(i);
+
+  const vector<loop> &loops = cfg.get_loops();
+  for (size_t li = 0; li < loops.size(); ++li) {
+    const loop &l = loops[li];
+    size_t h = l.header;
+    if (l.latches.size() != 1 or not f.has_preheader(h)) continue;
+    const vector<size_t> &preds = cfg.get_block(h).preds;
+    size_t kin = find(preds.begin(), preds.end(), h-1) - preds.begin();
+    size_t kback = find(preds.begin(), preds.end(), l.latches[0]) - preds.begin();
+    vector<instruction> &pre = f.get_preheader(h);
+    vector<phiNode> &phis = f.get_phis(h);
+    auto invariant = [&](const operand &o) {
+      if (o.is_temp()) {
+        auto p = defBlock.find(o.get_temp());
+        return p != defBlock.end() and not l.contains(p->second);
+      }
+      return o.is_const() or f.is_renamed(o);
+    };
+    // operand in a temporal or renamed variable, computed in the preheader if needed
+    auto in_preheader = [&](const operand &o) {
+      if (o.is_temp() or o.is_name()) return o;
+      operand t = f.new_temp();
+      pre.push_back(instruction(instruction::_ILOAD, t, o));
+      defBlock[t.get_temp()] = h-1;
+      intValue[t.get_temp()] = o.get_int();
+      return t;
+    };
+    auto product = [&](const operand &x, const operand &y) {
+      int32_t a = 0, b = 0;
+      bool ka = known(x, a), kb = known(y, b);
+      if (ka and kb) {
+        int64_t v = int64_t(a) * b;
+        if (v >= 0 and v <= INT32_MAX) return in_preheader(operand::INTCONST(int32_t(v)));
+      }
+      if ((ka and a == 0) or (kb and b == 0)) return in_preheader(operand::INTCONST(0));
+      if (ka and a == 1) return in_preheader(y);
+      if (kb and b == 1) return in_preheader(x);
+      operand t = f.new_temp();
+      pre.push_back(instruction(instruction::_MUL, t, in_preheader(x), in_preheader(y)));
+      defBlock[t.get_temp()] = h-1;
+      return t;
+    };
+
+    // basic induction variables
+    unordered_map<uint32_t, inductionVar> ivs;
+    for (auto &phi : phis) {
+      const operand &a = phi.args[kback];
+      if (not a.is_temp() or phi.args[kin].is_empty() or defPc.count(a.get_temp()) == 0) continue;
+      size_t pc = defPc[a.get_temp()];
+      if (cfg.get_loop_of(cfg.get_block_of(pc)) != li) continue;
+      const instruction &i = ins[pc];
+      inductionVar iv;
+      iv.var = phi.dest;
+      iv.updatePc = pc;
+      iv.down = (i.oper == instruction::_SUB);
+      if (i.oper == instruction::_ADD and i.arg2 == phi.dest and invariant(i.arg3)) iv.step = i.arg3;
+      else if (i.oper == instruction::_ADD and i.arg3 == phi.dest and invariant(i.arg2)) iv.step = i.arg2;
+      else if (i.oper == instruction::_SUB and i.arg2 == phi.dest and invariant(i.arg3)) iv.step = i.arg3;
+      else continue;
+      ivs[phi.dest.get_temp()] = iv;
+    }
+    if (ivs.empty()) continue;
+
+    // products of an induction variable and an invariant
+    vector<derivedVar> derived;
+    for (size_t b : l.blocks) {
+      if (not cfg.is_reachable(b)) continue;
+      for (size_t pc = cfg.get_block(b).first; pc < cfg.get_block(b).last; ++pc) {
+        instruction &i = ins[pc];
+        if (i.oper != instruction::_MUL or not i.arg1.is_temp()) continue;
+        operand p = i.arg2, k = i.arg3;
+        if (not (p.is_temp() and ivs.count(p.get_temp()) and invariant(k))) swap(p, k);
+        if (not (p.is_temp() and ivs.count(p.get_temp()) and invariant(k))) continue;
+
+        size_t d = 0;
+        while (d < derived.size() and not (derived[d].base == p and derived[d].factor == k)) ++d;
+        if (d == derived.size()) {
+          const inductionVar &iv = ivs[p.get_temp()];
+          const phiNode *phi = nullptr;
+          for (auto &ph : phis)
+            if (ph.dest == p) phi = &ph;
+          operand step = product(k, iv.step), init = product(phi->args[kin], k);
+          operand q = f.new_temp(), next = f.new_temp();
+          phiNode np;
+          np.var = np.dest = q;
+          np.args.assign(preds.size(), operand());
+          np.args[kin] = init;
+          np.args[kback] = next;
+          phis.push_back(np);
+          f.insert_after(iv.updatePc, instruction(iv.down ? instruction::_SUB : instruction::_ADD, next, q, step));
+          defBlock[q.get_temp()] = h;
+          defBlock[next.get_temp()] = cfg.get_block_of(iv.updatePc);
+          uses[q.get_temp()] = 1;
+          uses[next.get_temp()] = 1;
+          derivedVar dv;
+          dv.base = p;
+          dv.factor = k;
+          dv.var = q;
+          dv.known = known(k, dv.value);
+          derived.push_back(dv);
+        }
+        same[i.arg1.get_temp()] = derived[d].var;
+        --uses[p.get_temp()];
+        if (k.is_temp()) --uses[k.get_temp()];
+        rewrite(i, instruction::NOOP());
+      }
+    }
+
+    // induction variables used only by their update and the exit test
+    vector<operand> removed;
+    for (auto &dv : derived) {
+      if (not dv.known or dv.value <= 0) continue;
+      const inductionVar &iv = ivs[dv.base.get_temp()];
+      const instruction &upd = ins[iv.updatePc];
+      const phiNode *phi = nullptr;
+      for (auto &ph : phis)
+        if (ph.dest == iv.var) phi = &ph;
+      int32_t c = 0, init = 0;
+      if (iv.down or not known(iv.step, c) or c <= 0 or not known(phi->args[kin], init) or init < 0) continue;
+      if (uses[iv.var.get_temp()] != 2 or uses[upd.arg1.get_temp()] != 1) continue;
+      if (find(removed.begin(), removed.end(), iv.var) != removed.end()) continue;
+
+      // the test compares p with n at a jump that every iteration reaches
+      // and that leaves the loop when the test fails, so p never gets past
+      // n: "LT/LE t p n" and "FJUMP t L", or "IF[N]LT/IF[N]LE p n L"
+      size_t test = CFG::NONE;
+      for (size_t b : l.blocks) {
+        if (not cfg.is_reachable(b) or not cfg.dominates(b, l.latches[0])) continue;
+        size_t end = cfg.get_block(b).last - 1;
+        const instruction &j = ins[end];
+        size_t exit = CFG::NONE;
+        if (j.oper == instruction::_FJUMP or j.oper == instruction::_IFNLT or j.oper == instruction::_IFNLE)
+          exit = cfg.get_jump_target(b);
+        else if ((j.oper == instruction::_IFLT or j.oper == instruction::_IFLE) and b + 1 < nb)
+          exit = b + 1;
+        if (exit == CFG::NONE or l.contains(exit)) continue;
+        if (j.is_compare_jump() and j.arg1 == iv.var)
+          test = end;
+        else if (j.oper == instruction::_FJUMP and j.arg1.is_temp() and uses[j.arg1.get_temp()] == 1 and
+                 end > cfg.get_block(b).first and ins[end-1].defines_arg1() and ins[end-1].arg1 == j.arg1 and
+                 ins[end-1].uses_arg(2) and ins[end-1].arg2 == iv.var)
+          test = end - 1;
+      }
+      if (test == CFG::NONE) continue;
+      instruction &t = ins[test];
+      bool strict = (t.oper == instruction::_LT or t.oper == instruction::_IFLT or t.oper == instruction::_IFNLT);
+      bool ordered = strict or t.oper == instruction::_LE or t.oper == instruction::_IFLE or t.oper == instruction::_IFNLE;
+      operand &lhs = (t.is_compare_jump() ? t.arg1 : t.arg2);
+      operand &rhs = (t.is_compare_jump() ? t.arg2 : t.arg3);
+      int32_t n = 0;
+      if (not ordered or rhs == iv.var or not known(rhs, n))
+        continue;
+      // every value p takes (up to the first one failing the test)
+      // times k fits in an int, so the test on q is the same
+      int64_t last = max(int64_t(init), int64_t(n) + c - (strict ? 1 : 0));
+      int64_t k = dv.value;
+      if (n < 0 or last * k > INT32_MAX) continue;
+
+      lhs = dv.var;
+      rhs = in_preheader(operand::INTCONST(int32_t(n * k)));
+      ++uses[dv.var.get_temp()];
+      ins[iv.updatePc] = instruction::NOOP();
+      removed.push_back(iv.var);
+      ++reduced;
+    }
+    for (auto &v : removed)
+      for (size_t k = 0; k < phis.size(); ++k)
+        if (phis[k].dest == v) phis.erase(phis.begin() + k);
+  }
+
+  // doubling is cheaper as an addition
+  for (auto &i : ins) {
+    int32_t a = 0, b = 0;
+    if (i.oper != instruction::_MUL) continue;
+    if (known(i.arg3, b) and b == 2)
+      rewrite(i, instruction(instruction::_ADD, i.arg1, i.arg2, i.arg2));
+    else if (known(i.arg2, a) and a == 2)
+      rewrite(i, instruction(instruction::_ADD, i.arg1, i.arg3, i.arg3));
+  }
+
+  if (not same.empty()) replace_all();
+  return reduced;
+}
@@ -0,0 +1,55 @@
+/////////////////////////////////////////////////////////////////
+//
+//    StrengthReduction - Induction variables and cheaper arithmetic
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+#include "code.h"
+#include "SSA.h"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class strengthReduction replaces multiplications of a subroutine in
+/// SSA form by cheaper operations.
+///
+/// In a loop with a preheader and a single latch, a basic induction
+/// variable is a header phi p = phi(init, p + c), c loop invariant. A
+/// product t = p * k (k loop invariant) gets a new induction variable
+/// q = phi(init * k, q + c * k), updated next to p, so the loop adds
+/// instead of multiplying (e.g. the index of a[i*2+1]). When the only
+/// other use of p is then the exit test p < n (or p <= n), with
+/// constants that make the test equivalent on q, the test uses q and
+/// p is removed.
+///
+/// Operations with constants are simplified: x * 0, x * 1, x / 1,
+/// x + 0, x - 0 and x - x (left by a remainder by 1) need no operation,
+/// and x * 2 is x + x. The target machine has no shift or bitwise
+/// instructions, so other powers of two keep their MUL and DIV.
+
+class strengthReduction {
+public:
+  /// reduce the subroutine. Returns the number of operations replaced
+  static size_t run(ssaForm &f);
+};
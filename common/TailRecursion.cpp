@@ -0,0 +1,113 @@
+/////////////////////////////////////////////////////////////////
+//
+//    TailRecursion - Self-recursive tail calls turned into loops
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "TailRecursion.h"
+
+#include <vector>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+/// label added at the entry of the subroutine
+static const string ENTRY = "tailcall";
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'tailRecursion'
+
+/// turn self-recursive tail calls into jumps
+size_t tailRecursion::run(subroutine &s) {
+  const vector<instruction> &ins = s.get_instructions();
+  if (s.params.empty() or s.has_label(operand::LABEL(ENTRY))) return 0;
+  size_t nargs = s.params.size() - 1;
+
+  bool writesResult = false;
+  uint32_t next = 1;
+  for (auto &i : ins) {
+    if (i.oper == instruction::_ALOAD and i.arg2.is_name()) return 0;
+    if (i.defines_arg1() and i.arg1.is_name() and i.arg1.get_name() == "_result") writesResult = true;
+    for (int k = 1; k <= 3; ++k)
+      if (i.get_arg(k).is_temp()) next = max(next, i.get_arg(k).get_temp() + 1);
+  }
+
+  // instructions replacing each pc
+  map<size_t, vector<instruction>> edits;
+  size_t removed = 0;
+  for (size_t pc = 0; pc < ins.size(); ++pc) {
+    if (ins[pc].oper != instruction::_CALL or ins[pc].arg1.get_name() != s.get_name()) continue;
+    vector<size_t> pushes;
+    if (not s.match_call(pc, nargs, pushes)) continue;
+
+    // the result becomes ours, or is dropped by a subroutine without one
+    size_t q = pc + nargs + 2;
+    const operand &r = ins[q-1].arg1;
+    if (r.is_empty()) {
+      if (writesResult) continue;
+    }
+    else {
+      if (q >= ins.size() or ins[q].oper != instruction::_LOAD or ins[q].arg2 != r or
+          not ins[q].arg1.is_name() or ins[q].arg1.get_name() != "_result") continue;
+      ++q;
+    }
+    // then returns, maybe after some labels and jumps
+    for (size_t steps = 0; q < ins.size() and steps < ins.size(); ++steps) {
+      if (ins[q].oper == instruction::_LABEL) ++q;
+      else if (ins[q].oper == instruction::_UJUMP) q = s.get_label_pc(ins[q].arg1);
+      else break;
+    }
+    if (q >= ins.size() or ins[q].oper != instruction::_RETURN) continue;
+
+    // arguments to temporals, then to the parameters
+    vector<instruction> &jump = edits[pc];
+    edits[pushes[0]];
+    auto p = s.params.begin();
+    for (size_t k = 1; k <= nargs; ++k) {
+      operand t = operand::TEMP(next++);
+      edits[pushes[k]].push_back(instruction::LOAD(t, ins[pushes[k]].arg1));
+      jump.push_back(instruction::LOAD(operand::NAME((++p)->name), t));
+      edits[pc+k];
+    }
+    jump.push_back(instruction::UJUMP(ENTRY));
+    edits[pc+nargs+1];
+    if (not r.is_empty()) edits[pc+nargs+2];
+    ++removed;
+  }
+  if (removed == 0) return 0;
+
+  // the entry block stays apart, so the loop has a place for hoisted code
+  vector<instruction> out;
+  out.reserve(ins.size() + 2 + edits.size());
+  out.push_back(instruction::NOOP());
+  out.push_back(instruction::LABEL(ENTRY));
+  for (size_t pc = 0; pc < ins.size(); ++pc) {
+    auto e = edits.find(pc);
+    if (e == edits.end())
+      out.push_back(ins[pc]);
+    else
+      out.insert(out.end(), e->second.begin(), e->second.end());
+  }
+  s.set_instructions(out);
+  return removed;
+}
@@ -0,0 +1,51 @@
+/////////////////////////////////////////////////////////////////
+//
+//    TailRecursion - Self-recursive tail calls turned into loops
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+#include "code.h"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class tailRecursion replaces the calls a subroutine makes to itself
+/// in tail position by a jump to its beginning. A call is in tail
+/// position when the subroutine returns right after it, either giving
+/// the result of the call as its own (POP of the result, copy to
+/// '_result', RETURN) or, if it never writes '_result', ignoring it.
+///
+/// The arguments are copied to temporals where they were pushed, and
+/// to the parameters at the call, so an argument can still read the
+/// old value of any parameter. Then the code jumps to a label added
+/// at the entry, so accumulator-style recursion runs as a loop in one
+/// frame. Subroutines that take the address of a variable are left
+/// alone (the new arguments could point into the frame being reused).
+
+class tailRecursion {
+public:
+  /// turn self-recursive tail calls into jumps. Returns the number of
+  /// calls removed
+  static size_t run(subroutine &s);
+};
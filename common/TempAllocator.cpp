@@ -0,0 +1,141 @@
+/////////////////////////////////////////////////////////////////
+//
+//    TempAllocator - Reuse of temporals in a subroutine
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+#include "TempAllocator.h"
+#include "CFG.h"
+#include "Dataflow.h"
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'tempAllocator'
+
+/// rename the temporals of the subroutine. Returns how many remain
+size_t tempAllocator::run(subroutine &s) {
+  CFG g(s);
+  liveness lv(g);
+  const varIndex &vars = lv.get_vars();
+  size_t nv = vars.size();
+
+  bitVector temps(nv);
+  for (size_t v = 0; v < nv; ++v)
+    if (vars.get_operand(v).is_temp()) temps.set(v);
+
+  // a temporal interferes with every temporal live after its definition.
+  // Live temporals are kept as a sparse set while walking each block
+  // backwards, so each step costs only the number of live temporals
+  const size_t NONE = varIndex::NONE;
+  vector<vector<size_t>> adj(nv);
+  // temporals related by a move, colored alike when possible
+  vector<vector<size_t>> moves(nv);
+  vector<size_t> live, pos(nv, NONE);
+  auto add = [&](size_t t) { if (pos[t] == NONE) { pos[t] = live.size(); live.push_back(t); } };
+  auto remove = [&](size_t t) {
+    if (pos[t] == NONE) return;
+    live[pos[t]] = live.back();
+    pos[live.back()] = pos[t];
+    live.pop_back();
+    pos[t] = NONE;
+  };
+  const vector<instruction> &ins = s.get_instructions();
+  for (size_t b = 0; b < g.get_num_blocks(); ++b) {
+    const basicBlock &bb = g.get_block(b);
+    while (not live.empty()) remove(live.back());
+    const bitVector &out = lv.get_out(b);
+    for (size_t t = out.next(0); t < nv; t = out.next(t+1))
+      if (temps.test(t)) add(t);
+    for (size_t pc = bb.last; pc-- > bb.first; ) {
+      const instruction &i = ins[pc];
+      // the source of a move holds the same value: it does not interfere
+      size_t src = (i.oper == instruction::_LOAD and i.arg2.is_temp() ?
+                    vars.get_index(i.arg2) : NONE);
+      if (i.defines_arg1() and i.arg1.is_temp()) {
+        size_t t = vars.get_index(i.arg1);
+        if (src != NONE) {
+          moves[t].push_back(src);
+          moves[src].push_back(t);
+        }
+        for (size_t u : live) {
+          if (u == t or u == src) continue;
+          adj[t].push_back(u);
+          adj[u].push_back(t);
+        }
+        remove(t);
+      }
+      for (int k = 1; k <= 3; ++k)
+        if (i.uses_arg(k) and i.get_arg(k).is_temp()) add(vars.get_index(i.get_arg(k)));
+    }
+  }
+  // temporals read before being written (in any path) meet at the entry
+  if (g.get_num_blocks() > 0) {
+    bitVector entry = lv.get_in(0);
+    entry.intersect_with(temps);
+    for (size_t t = entry.next(0); t < nv; t = entry.next(t+1))
+      for (size_t u = entry.next(t+1); u < nv; u = entry.next(u+1)) {
+        adj[t].push_back(u);
+        adj[u].push_back(t);
+      }
+  }
+
+  // greedy coloring, in order of first appearance, preferring the
+  // color of a temporal it is moved from or to
+  vector<size_t> color(nv, NONE);
+  vector<size_t> taken;   // taken[c] == t if color c is used by a neighbour of t
+  size_t ncolors = 0;
+  for (size_t t = temps.next(0); t < nv; t = temps.next(t+1)) {
+    for (size_t u : adj[t])
+      if (color[u] != NONE) taken[color[u]] = t;
+    size_t c = NONE;
+    for (size_t u : moves[t])
+      if (color[u] != NONE and taken[color[u]] != t) {
+        c = color[u];
+        break;
+      }
+    if (c == NONE) {
+      c = 0;
+      while (c < ncolors and taken[c] == t) ++c;
+    }
+    if (c == ncolors) {
+      taken.push_back(NONE);
+      ++ncolors;
+    }
+    color[t] = c;
+  }
+
+  // rename, dropping the moves that became self copies
+  vector<instruction> v;
+  v.reserve(ins.size());
+  for (auto &i : ins) {
+    v.push_back(i);
+    for (int k = 1; k <= 3; ++k) {
+      operand &a = v.back().get_arg(k);
+      if (a.is_temp()) a = operand::TEMP(color[vars.get_index(a)] + 1);
+    }
+    if (v.back().oper == instruction::_LOAD and v.back().arg1 == v.back().arg2) v.pop_back();
+  }
+  s.set_instructions(v);
+  return ncolors;
+}
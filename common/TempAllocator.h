@@ -0,0 +1,45 @@
+/////////////////////////////////////////////////////////////////
+//
+//    TempAllocator - Reuse of temporals in a subroutine
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "code.h"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class tempAllocator renames the temporals (%N) of a subroutine so
+/// that temporals whose live ranges do not overlap share a number.
+/// CodeGenVisitor gets a fresh temporal from counters::newTEMP for
+/// every subexpression; after this pass a function uses about as many
+/// temporals as it needs at its most demanding point. Interferences
+/// come from liveness (see Dataflow.h) and are colored greedily in
+/// order of first appearance. Temporals related by a move get the same
+/// color when they do not interfere, and the move is then removed.
+
+class tempAllocator {
+public:
+  /// rename the temporals of the subroutine. Returns how many remain
+  static size_t run(subroutine &s);
+};
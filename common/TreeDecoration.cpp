@@ -50,6 +50,10 @@ bool TreeDecoration::getIsLValue(antlr4::ParserRuleContext *ctx) {
   return IsLValueDecor.get(ctx);
 }
 
+ConstValue TreeDecoration::getConstant(antlr4::ParserRuleContext *ctx) {
+  return ConstantDecor.get(ctx);
+}
+
 // Setters:
 void TreeDecoration::putScope(antlr4::ParserRuleContext *ctx, SymTable::ScopeId s) {
   ScopeDecor.put(ctx, s);
@@ -62,3 +66,7 @@ void TreeDecoration::putType(antlr4::ParserRuleContext *ctx, TypesMgr::TypeId t)
 void TreeDecoration::putIsLValue(antlr4::ParserRuleContext *ctx, bool b) {
   IsLValueDecor.put(ctx, b);
 }
+
+void TreeDecoration::putConstant(antlr4::ParserRuleContext *ctx, const ConstValue & v) {
+  ConstantDecor.put(ctx, v);
+}
@@ -35,19 +35,39 @@
 #include "antlr4-runtime.h"
 #include "tree/ParseTreeProperty.h"
 
+#include <cstdint>
+
 // using namespace std;
 
 
+//////////////////////////////////////////////////////////////////////
+// Class ConstValue: the value of an expression that can be computed
+// at compile time (only literals and operators applied to them). The
+// type of the expression tells which field holds the value: integers,
+// booleans (0/1) and characters use ival, and floats use fval.
+// A default constructed ConstValue is not known.
+
+class ConstValue {
+
+public:
+  bool    known = false;
+  int32_t ival  = 0;
+  float   fval  = 0;
+
+};  // class ConstValue
+
+
 //////////////////////////////////////////////////////////////////////
 // Class TreeDecoration: the nodes of the parser tree generated
 // by the antlr4 parser, whose base type is
 // antlr4::ParserRuleContext *, can have different attributes.
 // TreeDecoration groups all of them, and uses different
 // ParseTreeProperty to save this information.
-// Currently three kinds of attributes may be present:
+// Currently four kinds of attributes may be present:
 //   - scope, for nodes like the program, or functions
 //   - type, for expressions or type especification
 //   - isLValue, for expressions
+//   - constant, for expressions whose value is known at compile time
 // Different visitors set and access these attributes:
 //   - SymbolsVisitor     [TypeCheck phase 1]
 //       * set and access the scope attribute
@@ -56,9 +76,11 @@
 //       * access the scope attribute
 //       * set and access the type attribute (in expressions)
 //       * set and access the isLValue attribute (in expressions)
+//       * set and access the constant attribute (in expressions)
 //   - CodeGenVisitor     [Code Generation]
 //       * access the scope attribute
 //       * access the type attribute
+//       * access the constant attribute
 
 class TreeDecoration {
 
@@ -69,15 +91,18 @@ public:
   SymTable::ScopeId getScope    (antlr4::ParserRuleContext *ctx);
   TypesMgr::TypeId  getType     (antlr4::ParserRuleContext *ctx);
   bool              getIsLValue (antlr4::ParserRuleContext *ctx);
+  ConstValue        getConstant (antlr4::ParserRuleContext *ctx);
 
   // Setters:
   void putScope    (antlr4::ParserRuleContext *ctx, SymTable::ScopeId s);
   void putType     (antlr4::ParserRuleContext *ctx, TypesMgr::TypeId t);
   void putIsLValue (antlr4::ParserRuleContext *ctx, bool b);
+  void putConstant (antlr4::ParserRuleContext *ctx, const ConstValue & v);
 
 private:
   antlr4::tree::ParseTreeProperty<SymTable::ScopeId> ScopeDecor;
   antlr4::tree::ParseTreeProperty<TypesMgr::TypeId>  TypeDecor;
   antlr4::tree::ParseTreeProperty<bool>              IsLValueDecor;
+  antlr4::tree::ParseTreeProperty<ConstValue>        ConstantDecor;
 
 };  // class TreeDecoration
@@ -0,0 +1,214 @@
+/////////////////////////////////////////////////////////////////
+//
+//    ValueNumbering - Local and global value numbering
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#include "ValueNumbering.h"
+#include "CFG.h"
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+/// operation and operands of an expression
+namespace {
+  class exprKey {
+  public:
+    instruction::Operation op;
+    uint64_t a, b;
+    bool operator==(const exprKey &o) const { return op == o.op and a == o.a and b == o.b; }
+  };
+  class exprHash {
+  public:
+    size_t operator()(const exprKey &k) const {
+      return hash<uint64_t>()(k.a * 0x9e3779b97f4a7c15ULL ^ k.b) ^ (size_t(k.op) << 1);
+    }
+  };
+  typedef unordered_map<exprKey, operand, exprHash> exprTable;
+}
+
+/// kind and value of an operand packed in an integer
+static uint64_t operand_code(const operand &o) {
+  uint32_t bits = 0;
+  switch (o.get_kind()) {
+  case operand::_TEMP : bits = o.get_temp(); break;
+  case operand::_NAME :
+  case operand::_LABEL : bits = o.get_name_id(); break;
+  case operand::_INTCONST : bits = uint32_t(o.get_int()); break;
+  case operand::_CHARCONST : bits = uint8_t(o.get_char()); break;
+  case operand::_FLOATCONST : { float f = o.get_float(); memcpy(&bits, &f, sizeof(bits)); break; }
+  default : break;
+  }
+  return (uint64_t(o.get_kind()) << 32) | bits;
+}
+
+/// how an instruction can be numbered
+typedef enum {NOT_NUMBERED, PURE, READS_MEMORY} exprClass;
+
+static exprClass classify(const instruction &i, const ssaForm &f) {
+  if (not i.defines_arg1() or not i.arg1.is_temp()) return NOT_NUMBERED;
+  switch (i.oper) {
+  case instruction::_LOADX :
+  case instruction::_LOADC :
+    return READS_MEMORY;
+  case instruction::_ADD : case instruction::_SUB : case instruction::_MUL : case instruction::_DIV :
+  case instruction::_EQ : case instruction::_LT : case instruction::_LE :
+  case instruction::_NEG : case instruction::_NOT : case instruction::_AND : case instruction::_OR :
+  case instruction::_FLOAT :
+  case instruction::_FADD : case instruction::_FSUB : case instruction::_FMUL : case instruction::_FDIV :
+  case instruction::_FEQ : case instruction::_FLT : case instruction::_FLE : case instruction::_FNEG :
+  case instruction::_LOAD : case instruction::_ALOAD :
+    for (int k = 2; k <= 3; ++k)
+      if (i.uses_arg(k) and i.get_arg(k).is_name() and not f.is_renamed(i.get_arg(k)))
+        return READS_MEMORY;
+    return PURE;
+  default :
+    // input and popped values
+    return NOT_NUMBERED;
+  }
+}
+
+/// whether the instruction may write memory
+static bool clobbers(const instruction &i, const ssaForm &f) {
+  switch (i.oper) {
+  case instruction::_XLOAD :
+  case instruction::_CLOAD :
+  case instruction::_ACOPY :
+  case instruction::_CALL :
+  case instruction::_READI :
+  case instruction::_READF :
+  case instruction::_READC :
+    return true;
+  default :
+    return i.defines_arg1() and i.arg1.is_name() and not f.is_renamed(i.arg1);
+  }
+}
+
+static bool commutative(instruction::Operation op) {
+  switch (op) {
+  case instruction::_ADD : case instruction::_MUL : case instruction::_EQ :
+  case instruction::_AND : case instruction::_OR :
+  case instruction::_FADD : case instruction::_FMUL : case instruction::_FEQ :
+    return true;
+  default :
+    return false;
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'valueNumbering'
+
+/// remove redundant computations
+size_t valueNumbering::run(ssaForm &f) {
+  const CFG &cfg = f.get_cfg();
+  vector<instruction> &ins = f.get_instructions();
+  if (cfg.get_num_blocks() == 0) return 0;
+
+  // temporals whose value is held by an earlier one, and temporals
+  // holding a constant. Constants are cheaper to load again than to
+  // keep in a temporal, so their loads are not removed, but operations
+  // on the same constant match
+  unordered_map<uint32_t, operand> same;
+  unordered_map<uint32_t, uint64_t> constant;
+  auto code = [&](const operand &o) {
+    if (o.is_temp()) {
+      auto p = constant.find(o.get_temp());
+      if (p != constant.end()) return p->second;
+    }
+    return operand_code(o);
+  };
+  auto replace = [&](operand &o) {
+    if (not o.is_temp()) return;
+    auto p = same.find(o.get_temp());
+    if (p != same.end()) o = p->second;
+  };
+
+  // global table, with the keys added by each block on the dominator
+  // tree path (to forget them when leaving it), and local table
+  exprTable global, local;
+  vector<exprKey> added;
+  size_t removed = 0;
+
+  struct frame { size_t b, child, mark; };
+  vector<frame> stack;
+  stack.push_back(frame{0, 0, 0});
+  bool entering = true;
+  while (not stack.empty()) {
+    frame &fr = stack.back();
+    const basicBlock &bb = cfg.get_block(fr.b);
+    if (entering) {
+      fr.mark = added.size();
+      local.clear();
+      for (size_t pc = bb.first; pc < bb.last; ++pc) {
+        instruction &i = ins[pc];
+        for (int k = 1; k <= 3; ++k)
+          if (i.uses_arg(k)) replace(i.get_arg(k));
+        if (clobbers(i, f)) local.clear();
+        if ((i.oper == instruction::_ILOAD or i.oper == instruction::_FLOAD or i.oper == instruction::_CHLOAD)
+            and i.arg1.is_temp()) {
+          constant[i.arg1.get_temp()] = operand_code(i.arg2);
+          continue;
+        }
+        exprClass c = classify(i, f);
+        if (c == NOT_NUMBERED) continue;
+
+        exprKey key{i.oper, code(i.arg2), code(i.arg3)};
+        if (commutative(i.oper) and key.b < key.a) swap(key.a, key.b);
+        exprTable &table = (c == PURE ? global : local);
+        auto p = table.find(key);
+        if (p != table.end()) {
+          same[i.arg1.get_temp()] = p->second;
+          i = instruction::NOOP();
+          ++removed;
+          continue;
+        }
+        table.insert(make_pair(key, i.arg1));
+        if (c == PURE) added.push_back(key);
+      }
+    }
+    if (fr.child < bb.dom_children.size()) {
+      size_t c = bb.dom_children[fr.child++];
+      stack.push_back(frame{c, 0, 0});
+      entering = true;
+    }
+    else {
+      while (added.size() > fr.mark) {
+        global.erase(added.back());
+        added.pop_back();
+      }
+      stack.pop_back();
+      entering = false;
+    }
+  }
+
+  // phi arguments come from the end of the predecessors
+  if (removed > 0)
+    for (size_t b = 0; b < cfg.get_num_blocks(); ++b)
+      for (auto &phi : f.get_phis(b))
+        for (auto &a : phi.args) replace(a);
+  return removed;
+}
@@ -0,0 +1,51 @@
+/////////////////////////////////////////////////////////////////
+//
+//    ValueNumbering - Local and global value numbering
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+#include "code.h"
+#include "SSA.h"
+
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class valueNumbering removes redundant computations from a
+/// subroutine in SSA form: an instruction computing the same operation
+/// on the same values as one that dominates it is removed, and its
+/// uses read the earlier result (commutative operations match with
+/// their operands in either order).
+///
+/// Operations on temporals, constants and renamed variables (whose
+/// values never change in SSA form) are numbered globally, walking the
+/// dominator tree. Reads of memory (LOADX, LOADC, variables that are
+/// not renamed) are numbered only within a basic block, and forgotten
+/// at every instruction that may write memory: XLOAD, CLOAD, CALL,
+/// READ* and writes to variables that are not renamed.
+
+class valueNumbering {
+public:
+  /// remove redundant computations. Returns the number of instructions removed
+  static size_t run(ssaForm &f);
+};
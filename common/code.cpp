@@ -27,123 +27,303 @@
 ////////////////////////////////////////////////////////////////
 
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include "code.h"
 
 using namespace std;
 
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'nametable'
+
+deque<string> nametable::strs;
+unordered_map<string, uint32_t> nametable::ids;
+
+/// get id for given name, adding it to the table if it is new
+uint32_t nametable::intern(const std::string &s) {
+  auto p = ids.find(s);
+  if (p != ids.end()) return p->second;
+  uint32_t id = strs.size();
+  strs.push_back(s);
+  ids.insert(make_pair(s, id));
+  return id;
+}
+/// get id for given name without adding it
+bool nametable::lookup(const std::string &s, uint32_t &id) {
+  auto p = ids.find(s);
+  if (p == ids.end()) return false;
+  id = p->second;
+  return true;
+}
+/// get name for given id
+const string & nametable::get(uint32_t id) { return strs[id]; }
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'operand'
+
+/// Constructor
+operand::operand() {
+  kind = _NONE;
+  val.id = 0;
+}
+
+operand operand::TEMP(uint32_t n) { operand o; o.kind = _TEMP; o.val.id = n; return o; }
+operand operand::NAME(const std::string &name) { operand o; o.kind = _NAME; o.val.id = nametable::intern(name); return o; }
+operand operand::LABEL(const std::string &name) { operand o; o.kind = _LABEL; o.val.id = nametable::intern(name); return o; }
+operand operand::NAME_ID(uint32_t id) { operand o; o.kind = _NAME; o.val.id = id; return o; }
+operand operand::LABEL_ID(uint32_t id) { operand o; o.kind = _LABEL; o.val.id = id; return o; }
+operand operand::INTCONST(int32_t v) { operand o; o.kind = _INTCONST; o.val.ival = v; return o; }
+operand operand::FLOATCONST(float v) { operand o; o.kind = _FLOATCONST; o.val.fval = v; return o; }
+operand operand::CHARCONST(char c) { operand o; o.kind = _CHARCONST; o.val.id = 0; o.val.cval = c; return o; }
+operand operand::PC(uint32_t pc) { operand o; o.kind = _PC; o.val.id = pc; return o; }
+
+operand::Kind operand::get_kind() const { return Kind(kind); }
+bool operand::is_empty() const { return kind == _NONE; }
+bool operand::is_temp() const { return kind == _TEMP; }
+bool operand::is_name() const { return kind == _NAME; }
+bool operand::is_label() const { return kind == _LABEL; }
+bool operand::is_const() const { return kind == _INTCONST or kind == _FLOATCONST or kind == _CHARCONST; }
+bool operand::is_pc() const { return kind == _PC; }
+
+uint32_t operand::get_temp() const { return val.id; }
+const string & operand::get_name() const { return nametable::get(val.id); }
+uint32_t operand::get_name_id() const { return val.id; }
+int32_t operand::get_int() const { return val.ival; }
+float operand::get_float() const { return val.fval; }
+char operand::get_char() const { return val.cval; }
+uint32_t operand::get_pc() const { return val.id; }
+
+bool operand::operator==(const operand &o) const { return kind == o.kind and val.id == o.val.id; }
+bool operand::operator!=(const operand &o) const { return not (*this == o); }
+
+/// print operand as it appears in t-code
+void operand::dump(std::ostream &os) const {
+  switch (kind) {
+  case _TEMP : os << '%' << val.id; break;
+  case _NAME :
+  case _LABEL : os << nametable::get(val.id); break;
+  case _INTCONST : os << val.ival; break;
+  case _PC : os << '@' << val.id; break;
+  case _FLOATCONST : {
+    // tvm only accepts fixed notation, and needs the '.' to tell
+    // floats from ints: use the fewest decimals that give back the value
+    char buf[128];
+    for (int prec = 1; prec < 50; ++prec) {
+      snprintf(buf, sizeof(buf), "%.*f", prec, double(val.fval));
+      if (strtof(buf, nullptr) == val.fval) break;
+    }
+    os << buf;
+    break;
+  }
+  case _CHARCONST : {
+    if (val.cval == '\n') os << "'\\n'";
+    else if (val.cval == '\t') os << "'\\t'";
+    else if (val.cval == '\\') os << "'\\\\'";
+    else if (val.cval == '\'') os << "'\\''";
+    else os << '\'' << val.cval << '\'';
+    break;
+  }
+  default : break;
+  }
+}
+string operand::dump() const {
+  ostringstream os;
+  dump(os);
+  return os.str();
+}
+
+ostream & operator<<(ostream &os, const operand &o) {
+  o.dump(os);
+  return os;
+}
+
+
 ////////////////////////////////////////////////////////////////////
 /// Implementation for class 'instruction'
 
 /// Constructor
 instruction::instruction(Operation op,
-                         const std::string &a1, const std::string &a2, const std::string &a3) {
+                         const operand &a1, const operand &a2, const operand &a3) {
   oper = op;
   arg1 = a1;
   arg2 = a2;
   arg3 = a3;
 }
 
-instruction instruction::LABEL(const std::string &a1) { return instruction(_LABEL, a1); }
-instruction instruction::UJUMP(const std::string &a1) { return instruction(_UJUMP, a1); }
-instruction instruction::FJUMP(const std::string &a1, const std::string &a2) { return instruction(_FJUMP, a1, a2); }
-instruction instruction::PUSH(const std::string &a1) { return instruction(_PUSH, a1); }
-instruction instruction::POP(const std::string &a1) { return instruction(_POP, a1); }
-instruction instruction::CALL(const std::string &a1) { return instruction(_CALL, a1); }
+instruction instruction::LABEL(const std::string &a1) { return instruction(_LABEL, operand::LABEL(a1)); }
+instruction instruction::UJUMP(const std::string &a1) { return instruction(_UJUMP, operand::LABEL(a1)); }
+instruction instruction::FJUMP(const operand &a1, const std::string &a2) { return instruction(_FJUMP, a1, operand::LABEL(a2)); }
+instruction instruction::IFEQ(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFEQ, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFNEQ(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFNEQ, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFLT(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFLT, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFNLT(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFNLT, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFLE(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFLE, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFNLE(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFNLE, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFFEQ(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFFEQ, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFFNEQ(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFFNEQ, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFFLT(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFFLT, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFFNLT(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFFNLT, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFFLE(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFFLE, a1, a2, operand::LABEL(a3)); }
+instruction instruction::IFFNLE(const operand &a1, const operand &a2, const std::string &a3) { return instruction(_IFFNLE, a1, a2, operand::LABEL(a3)); }
+instruction instruction::PUSH(const operand &a1) { return instruction(_PUSH, a1); }
+instruction instruction::POP(const operand &a1) { return instruction(_POP, a1); }
+instruction instruction::CALL(const std::string &a1) { return instruction(_CALL, operand::NAME(a1)); }
 instruction instruction::RETURN() { return instruction(_RETURN); }
-instruction instruction::ADD(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_ADD, a1, a2, a3); }
-instruction instruction::SUB(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_SUB, a1, a2, a3); }
-instruction instruction::MUL(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_MUL, a1, a2, a3); }
-instruction instruction::DIV(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_DIV, a1, a2, a3); }
-instruction instruction::EQ(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_EQ, a1, a2, a3); }
-instruction instruction::LT(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_LT, a1, a2, a3); }
-instruction instruction::LE(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_LE, a1, a2, a3); }
-instruction instruction::AND(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_AND, a1, a2, a3); }
-instruction instruction::OR(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_OR, a1, a2, a3); }
-instruction instruction::FADD(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FADD, a1, a2, a3); }
-instruction instruction::FSUB(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FSUB, a1, a2, a3); }
-instruction instruction::FMUL(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FMUL, a1, a2, a3); }
-instruction instruction::FDIV(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FDIV, a1, a2, a3); }
-instruction instruction::FEQ(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FEQ, a1, a2, a3); }
-instruction instruction::FLT(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FLT, a1, a2, a3); }
-instruction instruction::FLE(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FLE, a1, a2, a3); }
-instruction instruction::NOT(const std::string &a1, const std::string &a2) { return instruction(_NOT, a1, a2); }
-instruction instruction::NEG(const std::string &a1, const std::string &a2) { return instruction(_NEG, a1, a2); }
-instruction instruction::FNEG(const std::string &a1, const std::string &a2) { return instruction(_FNEG, a1, a2); }
-instruction instruction::FLOAT(const std::string &a1, const std::string &a2) { return instruction(_FLOAT, a1, a2); }  
-instruction instruction::LOAD(const std::string &a1, const std::string &a2) { return instruction(_LOAD, a1, a2); }
-instruction instruction::ILOAD(const std::string &a1, const std::string &a2) { return instruction(_ILOAD, a1, a2); }
-instruction instruction::CHLOAD(const std::string &a1, const std::string &a2) { return instruction(_CHLOAD, a1, a2); }
-instruction instruction::FLOAD(const std::string &a1, const std::string &a2) { return instruction(_FLOAD, a1, a2); }
-instruction instruction::XLOAD(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_XLOAD, a1, a2, a3); }
-instruction instruction::LOADX(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_LOADX, a1, a2, a3); }
-instruction instruction::ALOAD(const std::string &a1, const std::string &a2) { return instruction(_ALOAD, a1, a2); }
-instruction instruction::LOADC(const std::string &a1, const std::string &a2) { return instruction(_LOADC, a1, a2); }
-instruction instruction::CLOAD(const std::string &a1, const std::string &a2) { return instruction(_CLOAD, a1, a2); }
-instruction instruction::READI(const std::string &a1) { return instruction(_READI, a1); }
-instruction instruction::READF(const std::string &a1) { return instruction(_READF, a1); }
-instruction instruction::READC(const std::string &a1) { return instruction(_READC, a1); }
-instruction instruction::WRITEI(const std::string &a1) { return instruction(_WRITEI, a1); }
-instruction instruction::WRITEF(const std::string &a1) { return instruction(_WRITEF, a1); }
-instruction instruction::WRITEC(const std::string &a1) { return instruction(_WRITEC, a1); }
+instruction instruction::ADD(const operand &a1, const operand &a2, const operand &a3) { return instruction(_ADD, a1, a2, a3); }
+instruction instruction::SUB(const operand &a1, const operand &a2, const operand &a3) { return instruction(_SUB, a1, a2, a3); }
+instruction instruction::MUL(const operand &a1, const operand &a2, const operand &a3) { return instruction(_MUL, a1, a2, a3); }
+instruction instruction::DIV(const operand &a1, const operand &a2, const operand &a3) { return instruction(_DIV, a1, a2, a3); }
+instruction instruction::EQ(const operand &a1, const operand &a2, const operand &a3) { return instruction(_EQ, a1, a2, a3); }
+instruction instruction::LT(const operand &a1, const operand &a2, const operand &a3) { return instruction(_LT, a1, a2, a3); }
+instruction instruction::LE(const operand &a1, const operand &a2, const operand &a3) { return instruction(_LE, a1, a2, a3); }
+instruction instruction::AND(const operand &a1, const operand &a2, const operand &a3) { return instruction(_AND, a1, a2, a3); }
+instruction instruction::OR(const operand &a1, const operand &a2, const operand &a3) { return instruction(_OR, a1, a2, a3); }
+instruction instruction::FADD(const operand &a1, const operand &a2, const operand &a3) { return instruction(_FADD, a1, a2, a3); }
+instruction instruction::FSUB(const operand &a1, const operand &a2, const operand &a3) { return instruction(_FSUB, a1, a2, a3); }
+instruction instruction::FMUL(const operand &a1, const operand &a2, const operand &a3) { return instruction(_FMUL, a1, a2, a3); }
+instruction instruction::FDIV(const operand &a1, const operand &a2, const operand &a3) { return instruction(_FDIV, a1, a2, a3); }
+instruction instruction::FEQ(const operand &a1, const operand &a2, const operand &a3) { return instruction(_FEQ, a1, a2, a3); }
+instruction instruction::FLT(const operand &a1, const operand &a2, const operand &a3) { return instruction(_FLT, a1, a2, a3); }
+instruction instruction::FLE(const operand &a1, const operand &a2, const operand &a3) { return instruction(_FLE, a1, a2, a3); }
+instruction instruction::NOT(const operand &a1, const operand &a2) { return instruction(_NOT, a1, a2); }
+instruction instruction::NEG(const operand &a1, const operand &a2) { return instruction(_NEG, a1, a2); }
+instruction instruction::FNEG(const operand &a1, const operand &a2) { return instruction(_FNEG, a1, a2); }
+instruction instruction::FLOAT(const operand &a1, const operand &a2) { return instruction(_FLOAT, a1, a2); }  
+instruction instruction::LOAD(const operand &a1, const operand &a2) { return instruction(_LOAD, a1, a2); }
+instruction instruction::ILOAD(const operand &a1, int32_t a2) { return instruction(_ILOAD, a1, operand::INTCONST(a2)); }
+instruction instruction::CHLOAD(const operand &a1, char a2) { return instruction(_CHLOAD, a1, operand::CHARCONST(a2)); }
+instruction instruction::FLOAD(const operand &a1, float a2) { return instruction(_FLOAD, a1, operand::FLOATCONST(a2)); }
+instruction instruction::XLOAD(const operand &a1, const operand &a2, const operand &a3) { return instruction(_XLOAD, a1, a2, a3); }
+instruction instruction::LOADX(const operand &a1, const operand &a2, const operand &a3) { return instruction(_LOADX, a1, a2, a3); }
+instruction instruction::ALOAD(const operand &a1, const operand &a2) { return instruction(_ALOAD, a1, a2); }
+instruction instruction::LOADC(const operand &a1, const operand &a2) { return instruction(_LOADC, a1, a2); }
+instruction instruction::CLOAD(const operand &a1, const operand &a2) { return instruction(_CLOAD, a1, a2); }
+instruction instruction::ACOPY(const operand &a1, const operand &a2, const operand &a3) { return instruction(_ACOPY, a1, a2, a3); }
+instruction instruction::READI(const operand &a1) { return instruction(_READI, a1); }
+instruction instruction::READF(const operand &a1) { return instruction(_READF, a1); }
+instruction instruction::READC(const operand &a1) { return instruction(_READC, a1); }
+instruction instruction::WRITEI(const operand &a1) { return instruction(_WRITEI, a1); }
+instruction instruction::WRITEF(const operand &a1) { return instruction(_WRITEF, a1); }
+instruction instruction::WRITEC(const operand &a1) { return instruction(_WRITEC, a1); }
 instruction instruction::WRITELN() { return instruction(_WRITELN); }
+instruction instruction::WRITES(const operand &a1) { return instruction(_WRITES, a1); }
 instruction instruction::NOOP() { return instruction(_NOOP); }
 
 
 /// Destructor
 instruction::~instruction() {}
 
-string instruction::dump() const {
-  string s;
-  string ind="   ";
+bool instruction::is_jump() const { return oper == _UJUMP or oper == _FJUMP or is_compare_jump(); }
+bool instruction::is_compare_jump() const { return oper >= _IFEQ and oper <= _IFFNLE; }
+const operand & instruction::get_jump_label() const { return oper == _UJUMP ? arg1 : oper == _FJUMP ? arg2 : arg3; }
+operand & instruction::get_jump_label() { return oper == _UJUMP ? arg1 : oper == _FJUMP ? arg2 : arg3; }
+
+const operand & instruction::get_arg(int k) const { return k == 1 ? arg1 : k == 2 ? arg2 : arg3; }
+operand & instruction::get_arg(int k) { return k == 1 ? arg1 : k == 2 ? arg2 : arg3; }
+
+bool instruction::defines_arg1() const {
   switch (oper) {
-  case instruction::_LABEL : { s = "label " + arg1 + " :"; ind = ""; break; }
-  case instruction::_UJUMP : { s = "goto " + arg1; break; }
-  case instruction::_FJUMP : { s = "ifFalse " + arg1 + " goto " +arg2; break; }
+  case _LABEL : case _UJUMP : case _FJUMP : case _PUSH : case _CALL : case _RETURN :
+  case _IFEQ : case _IFNEQ : case _IFLT : case _IFNLT : case _IFLE : case _IFNLE :
+  case _IFFEQ : case _IFFNEQ : case _IFFLT : case _IFFNLT : case _IFFLE : case _IFFNLE :
+  case _XLOAD : case _CLOAD : case _ACOPY : case _WRITEI : case _WRITEF : case _WRITEC : case _WRITELN : case _WRITES :
+  case _NOOP : case _INVALID :
+    return false;
+  case _POP :
+    return not arg1.is_empty();
+  default :
+    return true;
+  }
+}
+
+bool instruction::uses_arg(int k) const {
+  const operand &a = get_arg(k);
+  if (not (a.is_temp() or a.is_name())) return false;
+  switch (oper) {
+  case _LABEL : case _UJUMP : case _CALL : case _POP : case _READI : case _READF : case _READC :
+    return false;
+  case _FJUMP : case _PUSH : case _WRITEI : case _WRITEF : case _WRITEC :
+    return k == 1;
+  case _XLOAD : case _CLOAD : case _ACOPY :
+  case _IFEQ : case _IFNEQ : case _IFLT : case _IFNLT : case _IFLE : case _IFNLE :
+  case _IFFEQ : case _IFFNEQ : case _IFFLT : case _IFFNLT : case _IFFLE : case _IFFNLE :
+    return true;
+  default :
+    return k != 1;
+  }
+}
+
+void instruction::dump(std::ostream &os) const {
+  if (oper != instruction::_LABEL) os << "   ";
+  switch (oper) {
+  case instruction::_LABEL : { os << "label " << arg1 << " :"; break; }
+  case instruction::_UJUMP : { os << "goto " << arg1; break; }
+  case instruction::_FJUMP : { os << "ifFalse " << arg1 << " goto " << arg2; break; }
+  case instruction::_IFEQ : { os << "if " << arg1 << " == " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFNEQ : { os << "ifFalse " << arg1 << " == " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFLT : { os << "if " << arg1 << " < " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFNLT : { os << "ifFalse " << arg1 << " < " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFLE : { os << "if " << arg1 << " <= " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFNLE : { os << "ifFalse " << arg1 << " <= " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFFEQ : { os << "if " << arg1 << " ==. " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFFNEQ : { os << "ifFalse " << arg1 << " ==. " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFFLT : { os << "if " << arg1 << " <. " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFFNLT : { os << "ifFalse " << arg1 << " <. " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFFLE : { os << "if " << arg1 << " <=. " << arg2 << " goto " << arg3; break; }
+  case instruction::_IFFNLE : { os << "ifFalse " << arg1 << " <=. " << arg2 << " goto " << arg3; break; }
   case instruction::_LOAD : 
   case instruction::_FLOAD : 
-  case instruction::_ILOAD : { s = arg1 + " = " + arg2; break; } 
-  case instruction::_CHLOAD : { s = arg1 + " = '" + arg2 +"'"; break; } 
-  case instruction::_PUSH : { s = "pushparam " + (arg1.empty()? "" : arg1); break; }
-  case instruction::_POP : { s = "popparam " + (arg1.empty()? "" : arg1); break; }
-  case instruction::_CALL : { s = "call " + arg1; break; }
-  case instruction::_RETURN : { s = "return"; break; }
-  case instruction::_XLOAD : { s = arg1 + "[" + arg2 + "] = " + arg3; break; }
-  case instruction::_LOADX : { s = arg1 + " = " + arg2 + "[" + arg3 + "]"; break; }
-  case instruction::_ALOAD : { s = arg1 + " = &" + arg2; break; }
-  case instruction::_LOADC : { s = arg1 + " = *" + arg2; break; }
-  case instruction::_CLOAD : { s = "*" + arg1 + " = " + arg2; break; }
-  case instruction::_READI : { s = "readi " + arg1; break; }
-  case instruction::_READF : { s = "readf " + arg1; break; }
-  case instruction::_READC : { s = "readc " + arg1; break; }
-  case instruction::_WRITEI : { s = "writei " + arg1; break; }
-  case instruction::_WRITEF : { s = "writef " + arg1; break; }
-  case instruction::_WRITEC : { s = "writec " + arg1; break; }
-  case instruction::_WRITELN : { s = "writeln"; break; }
-  case instruction::_ADD : { s = arg1 + " = " + arg2 + " + " + arg3; break; }
-  case instruction::_SUB : { s = arg1 + " = " + arg2 + " - " + arg3; break; }
-  case instruction::_MUL : { s = arg1 + " = " + arg2 + " * " + arg3; break; }
-  case instruction::_DIV : { s = arg1 + " = " + arg2 + " / " + arg3; break; }
-  case instruction::_AND : { s = arg1 + " = " + arg2 + " and " + arg3; break; }
-  case instruction::_OR : { s = arg1 + " = " + arg2 + " or " + arg3; break; }
-  case instruction::_EQ : { s = arg1 + " = " + arg2 + " == " + arg3; break; }
-  case instruction::_LT : { s = arg1 + " = " + arg2 + " < " + arg3; break; }
-  case instruction::_LE : { s = arg1 + " = " + arg2 + " <= " + arg3; break; }
-  case instruction::_NOT : { s = arg1 + " = not " + arg2; break; }
-  case instruction::_NEG : { s = arg1 + " = - " + arg2; break; }
-  case instruction::_FADD : { s = arg1 + " = " + arg2 + " +. " + arg3; break; }
-  case instruction::_FSUB : { s = arg1 + " = " + arg2 + " -. " + arg3; break; }
-  case instruction::_FMUL : { s = arg1 + " = " + arg2 + " *. " + arg3; break; }
-  case instruction::_FDIV : { s = arg1 + " = " + arg2 + " /. " + arg3; break; }
-  case instruction::_FEQ : { s = arg1 + " = " + arg2 + " ==. " + arg3; break; }
-  case instruction::_FLT : { s = arg1 + " = " + arg2 + " <. " + arg3; break; }
-  case instruction::_FLE : { s =  arg1 + " = " + arg2 + " <=. " + arg3; break; }
-  case instruction::_FNEG : { s =  arg1 + " = -. " + arg2; break; }
-  case instruction::_FLOAT : { s = arg1 + " = float " + arg2; break; }
-  case instruction::_NOOP : { s = "noop"; break; }
-  default : { s = "????"; break; }
+  case instruction::_CHLOAD : 
+  case instruction::_ILOAD : { os << arg1 << " = " << arg2; break; } 
+  case instruction::_PUSH : { os << "pushparam " << arg1; break; }
+  case instruction::_POP : { os << "popparam " << arg1; break; }
+  case instruction::_CALL : { os << "call " << arg1; break; }
+  case instruction::_RETURN : { os << "return"; break; }
+  case instruction::_XLOAD : { os << arg1 << "[" << arg2 << "] = " << arg3; break; }
+  case instruction::_LOADX : { os << arg1 << " = " << arg2 << "[" << arg3 << "]"; break; }
+  case instruction::_ALOAD : { os << arg1 << " = &" << arg2; break; }
+  case instruction::_LOADC : { os << arg1 << " = *" << arg2; break; }
+  case instruction::_CLOAD : { os << "*" << arg1 << " = " << arg2; break; }
+  case instruction::_ACOPY : { os << "acopy " << arg1 << " " << arg2 << " " << arg3; break; }
+  case instruction::_READI : { os << "readi " << arg1; break; }
+  case instruction::_READF : { os << "readf " << arg1; break; }
+  case instruction::_READC : { os << "readc " << arg1; break; }
+  case instruction::_WRITEI : { os << "writei " << arg1; break; }
+  case instruction::_WRITEF : { os << "writef " << arg1; break; }
+  case instruction::_WRITEC : { os << "writec " << arg1; break; }
+  case instruction::_WRITELN : { os << "writeln"; break; }
+  case instruction::_WRITES : { os << "writes " << arg1; break; }
+  case instruction::_ADD : { os << arg1 << " = " << arg2 << " + " << arg3; break; }
+  case instruction::_SUB : { os << arg1 << " = " << arg2 << " - " << arg3; break; }
+  case instruction::_MUL : { os << arg1 << " = " << arg2 << " * " << arg3; break; }
+  case instruction::_DIV : { os << arg1 << " = " << arg2 << " / " << arg3; break; }
+  case instruction::_AND : { os << arg1 << " = " << arg2 << " and " << arg3; break; }
+  case instruction::_OR : { os << arg1 << " = " << arg2 << " or " << arg3; break; }
+  case instruction::_EQ : { os << arg1 << " = " << arg2 << " == " << arg3; break; }
+  case instruction::_LT : { os << arg1 << " = " << arg2 << " < " << arg3; break; }
+  case instruction::_LE : { os << arg1 << " = " << arg2 << " <= " << arg3; break; }
+  case instruction::_NOT : { os << arg1 << " = not " << arg2; break; }
+  case instruction::_NEG : { os << arg1 << " = - " << arg2; break; }
+  case instruction::_FADD : { os << arg1 << " = " << arg2 << " +. " << arg3; break; }
+  case instruction::_FSUB : { os << arg1 << " = " << arg2 << " -. " << arg3; break; }
+  case instruction::_FMUL : { os << arg1 << " = " << arg2 << " *. " << arg3; break; }
+  case instruction::_FDIV : { os << arg1 << " = " << arg2 << " /. " << arg3; break; }
+  case instruction::_FEQ : { os << arg1 << " = " << arg2 << " ==. " << arg3; break; }
+  case instruction::_FLT : { os << arg1 << " = " << arg2 << " <. " << arg3; break; }
+  case instruction::_FLE : { os << arg1 << " = " << arg2 << " <=. " << arg3; break; }
+  case instruction::_FNEG : { os << arg1 << " = -. " << arg2; break; }
+  case instruction::_FLOAT : { os << arg1 << " = float " << arg2; break; }
+  case instruction::_NOOP : { os << "noop"; break; }
+  default : { os << "????"; break; }
   }
-
-  return ind + s;
+}
+string instruction::dump() const {
+  ostringstream os;
+  dump(os);
+  return os.str();
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -157,25 +337,87 @@ instructionList instruction::operator||(const instructionList &lst) const {
 ////////////////////////////////////////////////////////////////////
 /// Implementation for class 'instructionList'
 
+class instructionList::node {
+public:
+  /// instruction (leaves only)
+  instruction inst;
+  /// concatenated lists (inner nodes only)
+  std::shared_ptr<node> left, right;
+  /// number of instructions below this node
+  size_t size;
+
+  node(const instruction &i) : inst(i), size(1) {}
+  node(const std::shared_ptr<node> &l, const std::shared_ptr<node> &r) :
+    inst(instruction::_INVALID), left(l), right(r), size(l->size + r->size) {}
+  ~node();
+};
+
+// release children iteratively: a long chain of concatenations would
+// otherwise be destroyed recursively, one stack frame per node
+instructionList::node::~node() {
+  if (not left) return;
+  vector<shared_ptr<node>> pending;
+  pending.push_back(std::move(left));
+  pending.push_back(std::move(right));
+  while (not pending.empty()) {
+    shared_ptr<node> n = std::move(pending.back());
+    pending.pop_back();
+    if (n.use_count() == 1 and n->left) {
+      pending.push_back(std::move(n->left));
+      pending.push_back(std::move(n->right));
+    }
+  }
+}
+
 // constructor
 instructionList::instructionList() {}
 // constructor from a single instruction
-instructionList::instructionList(const instruction &inst) { this->push_back(inst); }
+instructionList::instructionList(const instruction &inst) : root(make_shared<node>(inst)) {}
 // destructor
 instructionList::~instructionList() {}
 
 // concatenation of lists (or list+instruction, via automatic coertion)
 instructionList instructionList::operator||(const instructionList &lst) const {
-  instructionList newlist = (*this);
-  newlist.insert(newlist.end(), lst.begin(), lst.end());
+  if (not lst.root) return *this;
+  if (not root) return lst;
+  instructionList newlist;
+  newlist.root = make_shared<node>(root, lst.root);
   return newlist;
 }
 
+// number of instructions in the list
+size_t instructionList::size() const { return root ? root->size : 0; }
+bool instructionList::empty() const { return not root; }
+
+// append all instructions in the list, in order, to given vector
+void instructionList::flatten(std::vector<instruction> &v) const {
+  if (not root) return;
+  v.reserve(v.size() + root->size);
+  vector<const node *> stack(1, root.get());
+  while (not stack.empty()) {
+    const node *n = stack.back();
+    stack.pop_back();
+    if (n->left) {
+      stack.push_back(n->right.get());
+      stack.push_back(n->left.get());
+    }
+    else v.push_back(n->inst);
+  }
+}
+
 // print instructionList (for debugging)
+void instructionList::dump(std::ostream &os) const {
+  vector<instruction> v;
+  flatten(v);
+  for (auto &i : v) {
+    i.dump(os);
+    os << '\n';
+  }
+}
 string instructionList::dump() const {
-  string s;  
-  for (auto i : *this ) s += i.dump() + "\n";
-  return s;
+  ostringstream os;
+  dump(os);
+  return os.str();
 }
 
 
@@ -192,17 +434,21 @@ var::var(const std::string &n, size_t s) {
 var::~var() {}
 
 /// print (for debugging)
+void var::dump(std::ostream &os) const {
+  os << name;
+  if (size != 0) os << ' ' << size;
+}
 string var::dump() const {
-  if (size != 0)
-    return name + " " + std::to_string(size);
-  return name;
+  ostringstream os;
+  dump(os);
+  return os.str();
 }
 
 ////////////////////////////////////////////////////////////////////
 /// Implementation for class 'subroutine'
 
 /// constructor
-subroutine::subroutine(const string &sname) { name = sname; }
+subroutine::subroutine(const string &sname) { name = sname; finalized = false; }
 /// destructor
 subroutine::~subroutine() {}
 /// get subroutine name
@@ -215,46 +461,125 @@ void subroutine::add_var(const std::string &name, size_t sz) { vars.push_back(va
 void subroutine::add_param(const std::string &name) { params.push_back(var(name,0)); }
 /// add new instruction
 void subroutine::add_instruction(const instruction &inst) {
-  if (inst.oper == instruction::_LABEL) labels.insert(make_pair(inst.arg1,instructions.size()));
+  if (inst.oper == instruction::_LABEL) labels.insert(make_pair(inst.arg1.get_name_id(),instructions.size()));
   instructions.push_back(inst);
+  finalized = false;
 }
 /// add instruction list to current instructions
 void subroutine::add_instructions(const instructionList &lins) {
-  for (auto i : lins)
+  vector<instruction> v;
+  lins.flatten(v);
+  instructions.reserve(instructions.size() + v.size());
+  for (auto &i : v)
     this->add_instruction(i);
 }
 /// set instruction list (overwritting current instructions)
 void subroutine::set_instructions(const instructionList &lins) {
+  vector<instruction> v;
+  lins.flatten(v);
+  this->set_instructions(v);
+}
+void subroutine::set_instructions(const vector<instruction> &v) {
+  bool resolved = finalized;
   instructions.clear();
-  this->add_instructions(lins);
+  labels.clear();
+  instructions.reserve(v.size());
+  for (auto &i : v) {
+    this->add_instruction(i);
+    // the program counter of a jump is not valid in the new code
+    instruction &j = instructions.back();
+    if (j.oper == instruction::_UJUMP) j.arg2 = operand();
+    else if (j.oper == instruction::_FJUMP) j.arg3 = operand();
+  }
+  if (resolved) finalize();
+}
+/// resolve jump targets to program counters
+void subroutine::finalize() {
+  for (auto &i : instructions) {
+    if (i.oper == instruction::_UJUMP) i.arg2 = operand::PC(get_label_pc(i.arg1));
+    else if (i.oper == instruction::_FJUMP) i.arg3 = operand::PC(get_label_pc(i.arg2));
+  }
+  finalized = true;
+}
+/// check whether jump targets are resolved
+bool subroutine::is_finalized() const { return finalized; }
+/// get program counter of the target of a jump
+size_t subroutine::get_jump_pc(const instruction &jump) const {
+  if (finalized and jump.oper == instruction::_UJUMP) return jump.arg2.get_pc();
+  if (finalized and jump.oper == instruction::_FJUMP) return jump.arg3.get_pc();
+  return get_label_pc(jump.get_jump_label());
 }
+/// get all instructions
+const vector<instruction> & subroutine::get_instructions() const { return instructions; }
+/// get number of instructions
+size_t subroutine::get_num_instructions() const { return instructions.size(); }
 /// get instruction at given program counter
-instruction subroutine::get_instruction_at(size_t pc) const {
-  if (pc>=instructions.size()) return instruction(instruction::_INVALID);
+const instruction & subroutine::get_instruction_at(size_t pc) const {
+  static const instruction invalid(instruction::_INVALID);
+  if (pc>=instructions.size()) return invalid;
   return instructions[pc];
 }
-/// get program counter for given label
-size_t subroutine::get_label_pc(std::string &lab) const { return labels.find(lab)->second; }
+/// get program counter for given label (past the end if it is not defined)
+size_t subroutine::get_label_pc(const std::string &lab) const {
+  uint32_t id = 0;
+  if (not nametable::lookup(lab, id)) return instructions.size();
+  auto p = labels.find(id);
+  return p == labels.end() ? instructions.size() : p->second;
+}
+size_t subroutine::get_label_pc(const operand &lab) const {
+  auto p = labels.find(lab.get_name_id());
+  return p == labels.end() ? instructions.size() : p->second;
+}
+/// check whether given label is defined
+bool subroutine::has_label(const operand &lab) const { return labels.find(lab.get_name_id()) != labels.end(); }
+/// find the PUSHes and POPs of the call at 'pc'
+bool subroutine::match_call(size_t pc, size_t nargs, vector<size_t> &pushes) const {
+  // going back, each POP of an inner call hides a PUSH
+  pushes.clear();
+  size_t pending = 0;
+  for (size_t p = pc; p-- > 0 and pushes.size() < nargs + 1; ) {
+    const instruction &i = instructions[p];
+    if (i.oper == instruction::_LABEL or i.is_jump() or i.oper == instruction::_RETURN) return false;
+    if (i.oper == instruction::_POP) ++pending;
+    else if (i.oper == instruction::_PUSH) {
+      if (pending > 0) --pending;
+      else pushes.push_back(p);
+    }
+  }
+  if (pushes.size() != nargs + 1) return false;
+  reverse(pushes.begin(), pushes.end());
+  for (size_t k = 1; k <= nargs; ++k) {
+    const operand &a = instructions[pushes[k]].arg1;
+    if (not a.is_temp() and not a.is_name()) return false;
+  }
+  for (size_t k = 1; k <= nargs + 1; ++k) {
+    if (pc + k >= instructions.size() or instructions[pc+k].oper != instruction::_POP) return false;
+    if (k <= nargs and not instructions[pc+k].arg1.is_empty()) return false;
+  }
+  return true;
+}
 /// print (for debugging)
-string subroutine::dump() const {
-  string s;
-  s = "function " + name + "\n";
+void subroutine::dump(std::ostream &os) const {
+  os << "function " << name << "\n";
   if (not params.empty()) {
-    s += "  params\n" ;
-    for (auto p : params) s += "    " + p.dump() + "\n";
-    s += "  endparams\n\n";
+    os << "  params\n";
+    for (auto &p : params) { os << "    "; p.dump(os); os << "\n"; }
+    os << "  endparams\n\n";
   }
   if (not vars.empty()) {
-    s += "  vars\n";
-    for (auto v : vars) s += "    " + v.dump() + "\n";
-    s += "  endvars\n\n";
+    os << "  vars\n";
+    for (auto &v : vars) { os << "    "; v.dump(os); os << "\n"; }
+    os << "  endvars\n\n";
   }
 
-  string ind = "  ";
-  if (labels.empty()) ind="";
-  for (auto i : instructions) s += ind + i.dump() + "\n";  
-  s += "endfunction\n\n";
-  return s;
+  const char *ind = labels.empty() ? "" : "  ";
+  for (auto &i : instructions) { os << ind; i.dump(os); os << "\n"; }
+  os << "endfunction\n\n";
+}
+string subroutine::dump() const {
+  ostringstream os;
+  dump(os);
+  return os.str();
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -272,16 +597,51 @@ const subroutine& code::get_subroutine(const string &name) const {
   size_t p = names.find(name)->second;
   return subs[p];
 }
+/// get all subroutines
+const vector<subroutine>& code::get_subroutines() const { return subs; }
+vector<subroutine>& code::get_subroutines() { return subs; }
 /// add subroutine
 void code::add_subroutine(const subroutine &s) {
   subs.push_back(s);
   names.insert(make_pair(s.get_name(), subs.size()-1));
 }
+/// resolve jump targets in all subroutines
+void code::finalize() {
+  for (auto &s : subs) s.finalize();
+}
+/// add a string constant
+size_t code::add_string(const string &s) {
+  auto p = stringIds.find(s);
+  if (p != stringIds.end()) return p->second;
+  strings.push_back(s);
+  stringIds.insert(make_pair(s, strings.size()-1));
+  return strings.size()-1;
+}
+/// get all string constants
+const vector<string>& code::get_strings() const { return strings; }
 /// print (for debugging)
+void code::dump(std::ostream &os) const {
+  // the string constants go first, escaped as in ASL
+  if (not strings.empty()) {
+    os << "strings\n";
+    for (size_t n = 0; n < strings.size(); ++n) {
+      os << "  " << n << " \"";
+      for (char ch : strings[n]) {
+        if (ch == '\n') os << "\\n";
+        else if (ch == '\t') os << "\\t";
+        else if (ch == '"' or ch == '\\') os << '\\' << ch;
+        else os << ch;
+      }
+      os << "\"\n";
+    }
+    os << "endstrings\n\n";
+  }
+  for (auto &s : subs) s.dump(os);
+}
 string code::dump() const {
-  string c;
-  for (auto s : subs) c += s.dump();
-  return c;
+  ostringstream os;
+  dump(os);
+  return os.str();
 }
 
 
@@ -289,15 +649,21 @@ string code::dump() const {
 /// Static methods to manage counters
 int counters::countIF = 0;
 int counters::countWHILE = 0;
+int counters::countCOND = 0;
+int counters::countCOPY = 0;
 int counters::countTEMP = 0;
 
 string counters::newLabelIF() { return std::to_string(++countIF); }
 string counters::newLabelWHILE() { return std::to_string(++countWHILE); }
-string counters::newTEMP() { return std::to_string(++countTEMP); }
+string counters::newLabelCOND() { return std::to_string(++countCOND); }
+string counters::newLabelCOPY() { return std::to_string(++countCOPY); }
+operand counters::newTEMP() { return operand::TEMP(++countTEMP); }
 
 void counters::resetLabelIF() { countIF = 0; }
 void counters::resetLabelWHILE() { countWHILE = 0; }
+void counters::resetLabelCOND() { countCOND = 0; }
+void counters::resetLabelCOPY() { countCOPY = 0; }
 void counters::resetTEMP() { countTEMP = 0; }
 
-void counters::resetLabels() { resetLabelIF(); resetLabelWHILE(); }
+void counters::resetLabels() { resetLabelIF(); resetLabelWHILE(); resetLabelCOND(); resetLabelCOPY(); }
 void counters::reset() { resetLabels(); resetTEMP(); }
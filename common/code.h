@@ -30,31 +30,136 @@
 
 #include <map>
 #include <list>
+#include <deque>
 #include <vector>
+#include <memory>
+#include <string>
+#include <ostream>
+#include <unordered_map>
+#include <cstdint>
 
 /// predeclaration
 class instructionList;
 
 ////////////////////////////////////////////////////////////////////
+/// Class nametable interns the names (variables, parameters, subroutines
+/// and labels) used by instruction operands, so that each name is
+/// stored only once and operands can refer to it by a small integer id
+
+class nametable {
+private:
+  /// (a deque, so that references returned by 'get' stay valid when new names are added)
+  static std::deque<std::string> strs;
+  static std::unordered_map<std::string, uint32_t> ids;
+
+public:
+  /// get id for given name, adding it to the table if it is new
+  static uint32_t intern(const std::string &s);
+  /// get id for given name without adding it (false if unknown)
+  static bool lookup(const std::string &s, uint32_t &id);
+  /// get name for given id (the reference is valid for the whole run)
+  static const std::string & get(uint32_t id);
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class operand stores an instruction argument as a small tagged
+/// value: a temporal (%N), an interned name, a label, or an int,
+/// float or char immediate. Comparing two operands is an integer compare.
+
+class operand {
+public:
+  /// operand kinds
+  typedef enum {_NONE, _TEMP, _NAME, _LABEL, _INTCONST, _FLOATCONST, _CHARCONST, _PC} Kind;
+
+  /// constructor (empty operand)
+  operand();
+
+  /// ------ specific constructors for each kind of operand -------
+
+  // create temporal "%n"
+  static operand TEMP(uint32_t n);
+  // create variable, parameter or subroutine name
+  static operand NAME(const std::string &name);
+  // create label name
+  static operand LABEL(const std::string &name);
+  // create name or label from an already interned id
+  static operand NAME_ID(uint32_t id);
+  static operand LABEL_ID(uint32_t id);
+  // create integer immediate
+  static operand INTCONST(int32_t v);
+  // create float immediate
+  static operand FLOATCONST(float v);
+  // create character immediate
+  static operand CHARCONST(char c);
+  // create resolved jump target (program counter in the subroutine)
+  static operand PC(uint32_t pc);
+
+  /// get kind of operand
+  Kind get_kind() const;
+  bool is_empty() const;
+  bool is_temp() const;
+  bool is_name() const;
+  bool is_label() const;
+  bool is_const() const;
+  bool is_pc() const;
+
+  /// get value (the caller must check the kind of the operand)
+  uint32_t get_temp() const;
+  const std::string & get_name() const;   // for names and labels
+  uint32_t get_name_id() const;           // for names and labels
+  int32_t get_int() const;
+  float get_float() const;
+  char get_char() const;
+  uint32_t get_pc() const;
+
+  /// comparison (kind and value)
+  bool operator==(const operand &o) const;
+  bool operator!=(const operand &o) const;
+
+  // print operand as it appears in t-code
+  std::string dump() const;
+  void dump(std::ostream &os) const;
+
+private:
+  /// kind of operand (stored as a byte to keep instructions small)
+  uint8_t kind;
+  /// value: temp number, name id, or immediate
+  union {
+    uint32_t id;
+    int32_t  ival;
+    float    fval;
+    char     cval;
+  } val;
+};
+
+////////////////////////////////////////////////////// print operand to a stream (same as operand::dump)
+std::ostream & operator<<(std::ostream &os, const operand &o);
+
+
+////////////////
 /// Class instruction stores a VM instruction code with its operands
 
 class instruction {
 public:
   /// instruction codes
-  typedef enum {_LABEL, _UJUMP, _FJUMP, _PUSH, _POP, _CALL, _RETURN,
+  typedef enum {_LABEL, _UJUMP, _FJUMP,
+                _IFEQ, _IFNEQ, _IFLT, _IFNLT, _IFLE, _IFNLE,
+                _IFFEQ, _IFFNEQ, _IFFLT, _IFFNLT, _IFFLE, _IFFNLE,
+                _PUSH, _POP, _CALL, _RETURN,
                 _ADD, _SUB, _MUL, _DIV, _EQ, _LT, _LE, _NEG, _NOT, _AND, _OR, _FLOAT,
                 _FADD, _FSUB, _FMUL, _FDIV, _FEQ, _FLT, _FLE, _FNEG,
-                _LOAD, _ILOAD, _CHLOAD, _FLOAD, _XLOAD, _LOADX, _ALOAD, _LOADC, _CLOAD,
-                _READI, _READF, _READC, _WRITEI, _WRITEF, _WRITEC, _WRITELN, _NOOP, _INVALID} Operation;
+                _LOAD, _ILOAD, _CHLOAD, _FLOAD, _XLOAD, _LOADX, _ALOAD, _LOADC, _CLOAD, _ACOPY,
+                _READI, _READF, _READC, _WRITEI, _WRITEF, _WRITEC, _WRITELN, _WRITES, _NOOP, _INVALID} Operation;
   
   /// instruction code
   Operation oper;
   /// arguments
-  std::string arg1, arg2, arg3;
+  operand arg1, arg2, arg3;
   
   /// constructor
   instruction(Operation op,
-              const std::string &a1="", const std::string &a2="", const std::string &a3="");
+              const operand &a1=operand(), const operand &a2=operand(), const operand &a3=operand());
 
   /// destructor
   ~instruction();
@@ -62,6 +167,25 @@ public:
   // concatenation of instruction+list (or instruction+instruction, via automatic coertion)
   instructionList operator||(const instructionList &lst) const;
 
+  // true for UJUMP, FJUMP and the compare-and-branch instructions
+  bool is_jump() const;
+  // true for the compare-and-branch instructions (IFEQ ... IFFNLE),
+  // that compare arg1 with arg2 and jump to the label in arg3
+  bool is_compare_jump() const;
+  // target label of a jump
+  const operand & get_jump_label() const;
+  operand & get_jump_label();
+
+  // argument k (1..3)
+  const operand & get_arg(int k) const;
+  operand & get_arg(int k);
+  // true if the instruction writes its first argument (a temporal or
+  // variable). Stores through a pointer or into an array element
+  // (XLOAD, CLOAD, ACOPY) write memory, not their arguments
+  bool defines_arg1() const;
+  // true if argument k (1..3) is a temporal or variable read by the instruction
+  bool uses_arg(int k) const;
+
   /// ------ specific constructors for each instruction -------
 
   // create new instruction "a1 :"
@@ -69,99 +193,132 @@ public:
   // create new instruction "goto a1"
   static instruction UJUMP(const std::string &a1);
   // create new instruction "ifFalse a1 goto a2"
-  static instruction FJUMP(const std::string &a1, const std::string &a2);
+  static instruction FJUMP(const operand &a1, const std::string &a2);
+  // create new instruction "if a1 == a2 goto a3"
+  static instruction IFEQ(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 == a2 goto a3"
+  static instruction IFNEQ(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "if a1 < a2 goto a3"
+  static instruction IFLT(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 < a2 goto a3"
+  static instruction IFNLT(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "if a1 <= a2 goto a3"
+  static instruction IFLE(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 <= a2 goto a3"
+  static instruction IFNLE(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "if a1 ==. a2 goto a3"
+  static instruction IFFEQ(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 ==. a2 goto a3"
+  static instruction IFFNEQ(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "if a1 <. a2 goto a3"
+  static instruction IFFLT(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 <. a2 goto a3"
+  static instruction IFFNLT(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "if a1 <=. a2 goto a3"
+  static instruction IFFLE(const operand &a1, const operand &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 <=. a2 goto a3"
+  static instruction IFFNLE(const operand &a1, const operand &a2, const std::string &a3);
   // create new instruction "pushparam a1"
-  static instruction PUSH(const std::string &a1="");
+  static instruction PUSH(const operand &a1=operand());
   // create new instruction "popparam a1"
-  static instruction POP(const std::string &a1="");
+  static instruction POP(const operand &a1=operand());
   // create new instruction "call a1"
   static instruction CALL(const std::string &a1);
   // create new instruction "return"
   static instruction RETURN();
   // create new instruction "a1 = a2 + a3"
-  static instruction ADD(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction ADD(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 - a3"
-  static instruction SUB(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction SUB(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 * a3"
-  static instruction MUL(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction MUL(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 / a3"
-  static instruction DIV(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction DIV(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 == a3"
-  static instruction EQ(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction EQ(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 < a3"
-  static instruction LT(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction LT(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 <= a3"
-  static instruction LE(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction LE(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 and a3"
-  static instruction AND(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction AND(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 or a3"
-  static instruction OR(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction OR(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 +. a3"
-  static instruction FADD(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction FADD(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 -. a3"
-  static instruction FSUB(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction FSUB(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 *. a3"
-  static instruction FMUL(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction FMUL(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 /. a3"
-  static instruction FDIV(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction FDIV(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 ==. a3"
-  static instruction FEQ(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction FEQ(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 <. a3"
-  static instruction FLT(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction FLT(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2 <=. a3"
-  static instruction FLE(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction FLE(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = not a2"
-  static instruction NOT(const std::string &a1, const std::string &a2);
+  static instruction NOT(const operand &a1, const operand &a2);
   // create new instruction "a1 = - a2"
-  static instruction NEG(const std::string &a1, const std::string &a2);
+  static instruction NEG(const operand &a1, const operand &a2);
   // create new instruction "a1 = -. a2"
-  static instruction FNEG(const std::string &a1, const std::string &a2);
+  static instruction FNEG(const operand &a1, const operand &a2);
   // create new instruction "a1 = float a2"
-  static instruction FLOAT(const std::string &a1, const std::string &a2);  
+  static instruction FLOAT(const operand &a1, const operand &a2);  
   // create new instruction "a1 = a2"
-  static instruction LOAD(const std::string &a1, const std::string &a2);
+  static instruction LOAD(const operand &a1, const operand &a2);
   // create new instruction "a1 = a2" (where a2 is an integer constant)
-  static instruction ILOAD(const std::string &a1, const std::string &a2);
+  static instruction ILOAD(const operand &a1, int32_t a2);
   // create new instruction "a1 = a2" (where a2 is a character constant)
-  static instruction CHLOAD(const std::string &a1, const std::string &a2);
+  static instruction CHLOAD(const operand &a1, char a2);
   // create new instruction "a1 = a2" (where a2 is a float constant)
-  static instruction FLOAD(const std::string &a1, const std::string &a2);
+  static instruction FLOAD(const operand &a1, float a2);
   // create new instruction "a1[a2] = a3" 
-  static instruction XLOAD(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction XLOAD(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = a2[a3]" 
-  static instruction LOADX(const std::string &a1, const std::string &a2, const std::string &a3);
+  static instruction LOADX(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "a1 = &a2" 
-  static instruction ALOAD(const std::string &a1, const std::string &a2);
+  static instruction ALOAD(const operand &a1, const operand &a2);
   // create new instruction "a1 = *a2" 
-  static instruction LOADC(const std::string &a1, const std::string &a2);
+  static instruction LOADC(const operand &a1, const operand &a2);
   // create new instruction "*a1 = a2" 
-  static instruction CLOAD(const std::string &a1, const std::string &a2);
+  static instruction CLOAD(const operand &a1, const operand &a2);
+  // create new instruction "acopy a1 a2 a3" (a1[0..a3-1] = a2[0..a3-1])
+  static instruction ACOPY(const operand &a1, const operand &a2, const operand &a3);
   // create new instruction "readi a1" 
-  static instruction READI(const std::string &a1);
+  static instruction READI(const operand &a1);
   // create new instruction "readf a1" 
-  static instruction READF(const std::string &a1);
+  static instruction READF(const operand &a1);
   // create new instruction "readc a1" 
-  static instruction READC(const std::string &a1);
+  static instruction READC(const operand &a1);
   // create new instruction "writei a1" 
-  static instruction WRITEI(const std::string &a1); 
+  static instruction WRITEI(const operand &a1); 
   // create new instruction "writef a1" 
-  static instruction WRITEF(const std::string &a1);
+  static instruction WRITEF(const operand &a1);
   // create new instruction "writec a1" 
-  static instruction WRITEC(const std::string &a1);
+  static instruction WRITEC(const operand &a1);
   // create new instruction "writeln" 
   static instruction WRITELN();
+  // create new instruction "writes a1" (a1 is the index of a string in code::get_strings)
+  static instruction WRITES(const operand &a1);
   // create new instruction "noop" (not really needed) 
   static instruction NOOP();
   
   // print instruction
   std::string dump() const;   
+  void dump(std::ostream &os) const;
 };
 
 
 ////////////////////////////////////////////////////////////////////
-/// Class instructionList stores a list of instructions
+/// Class instructionList stores a list of instructions. Lists are
+/// immutable and share their contents: concatenation just links both
+/// operands under a new node, so 'code = code || codeS' takes constant
+/// time whatever their lengths. Instructions are laid out in order
+/// only when the list is flattened (e.g. by subroutine::set_instructions)
 
-class instructionList : public std::vector<instruction> {
+class instructionList {
 public:
   // constructor
   instructionList();
@@ -173,8 +330,20 @@ public:
   // concatenation of lists (or list+instruction, via automatic coertion)
   instructionList operator||(const instructionList &lst) const;
 
+  // number of instructions in the list
+  size_t size() const;
+  bool empty() const;
+  // append all instructions in the list, in order, to given vector
+  void flatten(std::vector<instruction> &v) const;
+
   // print instructionList
   std::string dump() const;   
+  void dump(std::ostream &os) const;
+
+private:
+  /// a node is either a single instruction or the concatenation of two lists
+  class node;
+  std::shared_ptr<node> root;
 };
 
 
@@ -191,6 +360,7 @@ public:
 
   // print var
   std::string dump() const; 
+  void dump(std::ostream &os) const;
 };
 
 
@@ -203,9 +373,11 @@ private:
   /// name of the subroutine
   std::string name;
   /// instructions
-  instructionList instructions;
-  /// map label name -> position in instructions
-  std::map<std::string, size_t> labels;
+  std::vector<instruction> instructions;
+  /// map label name id -> position in instructions
+  std::unordered_map<uint32_t, size_t> labels;
+  /// whether jump targets have been resolved to program counters
+  bool finalized;
 
 public:
   /// list of local variables
@@ -229,16 +401,45 @@ public:
   void add_instruction(const instruction &inst);
   /// add instruction list to current instructions
   void add_instructions(const instructionList &lins);
-  /// set instruction list (overwritting current instructions)
+  /// set instruction list (overwritting current instructions). Jump
+  /// targets are resolved again if they were (see finalize)
   void set_instructions(const instructionList &lins);
+  void set_instructions(const std::vector<instruction> &v);
   
+  /// resolve jump targets: every UJUMP/FJUMP gets the program counter
+  /// of its label as an extra operand (see get_jump_pc).
+  /// Adding instructions afterwards undoes it.
+  void finalize();
+  /// check whether jump targets are resolved
+  bool is_finalized() const;
+  /// get program counter of the target of a jump (compare-and-branch
+  /// instructions use all their operands, and always go through the label)
+  size_t get_jump_pc(const instruction &jump) const;
+
+  /// get all instructions in subroutine
+  const std::vector<instruction> & get_instructions() const;
+  /// get number of instructions in subroutine
+  size_t get_num_instructions() const;
   /// get instruction at given program counter in subroutine
-  instruction get_instruction_at(size_t pc) const;
-  /// get program counter in subroutine for given label
-  size_t get_label_pc(std::string &lab) const;
+  /// (an _INVALID instruction if pc is out of range)
+  const instruction & get_instruction_at(size_t pc) const;
+  /// get program counter in subroutine for given label (the number
+  /// of instructions, where get_instruction_at is _INVALID, if the
+  /// label is not defined)
+  size_t get_label_pc(const std::string &lab) const;
+  size_t get_label_pc(const operand &lab) const;
+  /// check whether given label is defined in the subroutine
+  bool has_label(const operand &lab) const;
+  /// find the PUSHes of the result slot and of the 'nargs' arguments
+  /// of the CALL at 'pc', in the straight-line code before it, as
+  /// CodeGenVisitor emits them. False unless every argument is a
+  /// variable or a temporal and the call is followed by its POPs (only
+  /// the last one, of the result, may have an operand)
+  bool match_call(size_t pc, size_t nargs, std::vector<size_t> &pushes) const;
 
   // print subroutine (params, vars, and instructions)
   std::string dump() const;
+  void dump(std::ostream &os) const;
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -250,6 +451,9 @@ private:
   std::vector<subroutine> subs;
   /// index to access subroutines by name
   std::map<std::string, size_t> names;
+  /// string constants (see instruction::WRITES), and index of each one
+  std::vector<std::string> strings;
+  std::unordered_map<std::string, size_t> stringIds;
   
 public:
   /// constructor and destructor
@@ -260,11 +464,23 @@ public:
   subroutine& get_last_subroutine();
   /// get subroutine by name
   const subroutine& get_subroutine(const std::string &name) const;
+  /// get all subroutines, in the order they were added
+  const std::vector<subroutine>& get_subroutines() const;
+  std::vector<subroutine>& get_subroutines();
   /// add new subroutine
   void add_subroutine(const subroutine &s);
-
-  // print code (all info for all subroutines)
+  /// resolve jump targets in all subroutines (see subroutine::finalize)
+  void finalize();
+  /// add a string constant (or find it, if it was already added). Returns its index
+  size_t add_string(const std::string &s);
+  /// get all string constants
+  const std::vector<std::string>& get_strings() const;
+
+  // print code (all info for all subroutines). The stream version
+  // writes each instruction straight to 'os', without building the
+  // whole program text in memory
   std::string dump() const;
+  void dump(std::ostream &os) const;
 };
 
 
@@ -275,22 +491,31 @@ class counters {
 private:
   static int countIF;
   static int countWHILE;
+  static int countCOND;
+  static int countCOPY;
   static int countTEMP;
 
 public:
-  // return id for new label or temp (id is a number, but returned as string
+  // return id for new label (id is a number, but returned as string
   // to ease concatenation with other literals (e.g. "labelIF" + "4" -> "LabelIF4")
   static std::string newLabelIF();
   static std::string newLabelWHILE();
-  static std::string newTEMP();
+  // (labels inside short-circuit conditions)
+  static std::string newLabelCOND();
+  // (loops copying arrays)
+  static std::string newLabelCOPY();
+  // return a new temporal operand (%N)
+  static operand newTEMP();
   
   // reset individual counters 
   static void resetLabelIF();
   static void resetLabelWHILE();
+  static void resetLabelCOND();
+  static void resetLabelCOPY();
   static void resetTEMP();
   
-  // reset label counters (IF and WHILE)
+  // reset label counters (IF, WHILE, COND and COPY)
   static void resetLabels();
-  // reset all counters (IF, WHILE, and TEMP)
+  // reset all counters (IF, WHILE, COND, COPY, and TEMP)
   static void reset();
 };
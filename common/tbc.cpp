@@ -0,0 +1,343 @@
+/////////////////////////////////////////////////////////////////
+//
+//    tbc - Binary t-code object files
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#include "tbc.h"
+
+#include <unordered_map>
+#include <cstring>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>   // fstat
+
+using namespace std;
+
+static const char TBC_MAGIC[4] = {'T', 'B', 'C', '\0'};
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'tbcWriter'
+
+/// collects the string table while the program is serialized
+class tbcStrings {
+public:
+  vector<uint32_t> offsets;
+  string bytes;
+  unordered_map<uint32_t, uint32_t> index;   // nametable id -> string index
+
+  uint32_t add(uint32_t id) {
+    auto p = index.find(id);
+    if (p != index.end()) return p->second;
+    uint32_t n = offsets.size();
+    offsets.push_back(bytes.size());
+    bytes += nametable::get(id);
+    bytes += '\0';
+    index.insert(make_pair(id, n));
+    return n;
+  }
+  uint32_t add(const string &s) { return add(nametable::intern(s)); }
+};
+
+/// value of an operand as stored in a tbcInstr
+static uint32_t encode_operand(const operand &o, tbcStrings &strs) {
+  switch (o.get_kind()) {
+  case operand::_TEMP : return o.get_temp();
+  case operand::_NAME :
+  case operand::_LABEL : return strs.add(o.get_name_id());
+  case operand::_INTCONST : return uint32_t(o.get_int());
+  case operand::_FLOATCONST : { float f = o.get_float(); uint32_t v; memcpy(&v, &f, 4); return v; }
+  case operand::_CHARCONST : return uint8_t(o.get_char());
+  case operand::_PC : return o.get_pc();
+  default : return 0;
+  }
+}
+
+/// write given program to given (binary) stream
+void tbcWriter::write(const code &c, std::ostream &os) {
+  tbcStrings strs;
+  vector<tbcSub> subs;
+  vector<tbcVar> vars;
+  vector<tbcInstr> instrs;
+  vector<tbcLabel> labels;
+
+  for (auto &s : c.get_subroutines()) {
+    tbcSub ts;
+    ts.name = strs.add(s.get_name());
+    ts.first_param = vars.size();
+    for (auto &p : s.params) vars.push_back(tbcVar{strs.add(p.name), uint32_t(p.size)});
+    ts.num_params = vars.size() - ts.first_param;
+    ts.first_var = vars.size();
+    for (auto &v : s.vars) vars.push_back(tbcVar{strs.add(v.name), uint32_t(v.size)});
+    ts.num_vars = vars.size() - ts.first_var;
+
+    const vector<instruction> &ins = s.get_instructions();
+    ts.first_instr = instrs.size();
+    ts.num_instrs = ins.size();
+    ts.first_label = labels.size();
+    for (size_t pc = 0; pc < ins.size(); ++pc) {
+      const instruction &i = ins[pc];
+      const operand *args[3] = {&i.arg1, &i.arg2, &i.arg3};
+      tbcInstr ti;
+      ti.oper = uint8_t(i.oper);
+      for (int k = 0; k < 3; ++k) {
+        ti.kind[k] = uint8_t(args[k]->get_kind());
+        ti.val[k] = encode_operand(*args[k], strs);
+      }
+      // jumps always carry their target pc, finalized or not (in place
+      // of the label for compare-and-branch, that use all three arguments)
+      if (i.is_jump()) {
+        int k = (i.oper == instruction::_UJUMP ? 1 : 2);
+        ti.kind[k] = uint8_t(operand::_PC);
+        ti.val[k] = s.get_label_pc(i.get_jump_label());
+      }
+      else if (i.oper == instruction::_LABEL)
+        labels.push_back(tbcLabel{ti.val[0], uint32_t(pc)});
+      instrs.push_back(ti);
+    }
+    ts.num_labels = labels.size() - ts.first_label;
+    subs.push_back(ts);
+  }
+  vector<uint32_t> consts;
+  for (auto &str : c.get_strings()) consts.push_back(strs.add(str));
+
+  strs.offsets.push_back(strs.bytes.size());
+  while (strs.bytes.size() % 4 != 0) strs.bytes += '\0';
+
+  tbcHeader h;
+  memcpy(h.magic, TBC_MAGIC, 4);
+  h.version = TBC_VERSION;
+  h.num_strings = strs.offsets.size() - 1;
+  h.string_bytes = strs.bytes.size();
+  h.num_subs = subs.size();
+  h.num_vars = vars.size();
+  h.num_instrs = instrs.size();
+  h.num_labels = labels.size();
+  h.num_consts = consts.size();
+
+  os.write((const char *)&h, sizeof(h));
+  os.write((const char *)strs.offsets.data(), strs.offsets.size() * sizeof(uint32_t));
+  os.write(strs.bytes.data(), strs.bytes.size());
+  os.write((const char *)subs.data(), subs.size() * sizeof(tbcSub));
+  os.write((const char *)vars.data(), vars.size() * sizeof(tbcVar));
+  os.write((const char *)instrs.data(), instrs.size() * sizeof(tbcInstr));
+  os.write((const char *)labels.data(), labels.size() * sizeof(tbcLabel));
+  os.write((const char *)consts.data(), consts.size() * sizeof(uint32_t));
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'tbcImage'
+
+/// constructor
+tbcImage::tbcImage() : base(nullptr), length(0), header(nullptr) {}
+/// destructor
+tbcImage::~tbcImage() { close(); }
+
+/// map given file
+bool tbcImage::open(const std::string &fname) {
+  close();
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 or size_t(st.st_size) < sizeof(tbcHeader)) {
+    ::close(fd);
+    return false;
+  }
+  void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) return false;
+  base = (const char *)p;
+  length = st.st_size;
+
+  header = (const tbcHeader *)base;
+  if (memcmp(header->magic, TBC_MAGIC, 4) != 0 or header->version != TBC_VERSION) {
+    close();
+    return false;
+  }
+  // locate sections (64-bit arithmetic, so that a corrupt header can not overflow)
+  uint64_t off = sizeof(tbcHeader);
+  uint64_t o_offsets = off;     off += (uint64_t(header->num_strings) + 1) * sizeof(uint32_t);
+  uint64_t o_bytes = off;       off += header->string_bytes;
+  uint64_t o_subs = off;        off += uint64_t(header->num_subs) * sizeof(tbcSub);
+  uint64_t o_vars = off;        off += uint64_t(header->num_vars) * sizeof(tbcVar);
+  uint64_t o_instrs = off;      off += uint64_t(header->num_instrs) * sizeof(tbcInstr);
+  uint64_t o_labels = off;      off += uint64_t(header->num_labels) * sizeof(tbcLabel);
+  uint64_t o_consts = off;      off += uint64_t(header->num_consts) * sizeof(uint32_t);
+  if (off != length or header->string_bytes % 4 != 0) {
+    close();
+    return false;
+  }
+  str_offsets = (const uint32_t *)(base + o_offsets);
+  str_bytes = base + o_bytes;
+  subs = (const tbcSub *)(base + o_subs);
+  vars = (const tbcVar *)(base + o_vars);
+  instrs = (const tbcInstr *)(base + o_instrs);
+  labels = (const tbcLabel *)(base + o_labels);
+  consts = (const uint32_t *)(base + o_consts);
+
+  if (not check()) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+/// check that all sections and indexes are inside the file
+bool tbcImage::check() const {
+  const tbcHeader &h = *header;
+  for (uint32_t i = 0; i < h.num_strings; ++i) {
+    if (str_offsets[i] >= str_offsets[i+1] or str_offsets[i+1] > h.string_bytes or
+        str_bytes[str_offsets[i+1]-1] != '\0')
+      return false;
+  }
+  for (uint32_t i = 0; i < h.num_vars; ++i)
+    if (vars[i].name >= h.num_strings) return false;
+  for (uint32_t i = 0; i < h.num_labels; ++i)
+    if (labels[i].name >= h.num_strings) return false;
+  for (uint32_t i = 0; i < h.num_consts; ++i)
+    if (consts[i] >= h.num_strings) return false;
+
+  for (uint32_t n = 0; n < h.num_subs; ++n) {
+    const tbcSub &s = subs[n];
+    if (s.name >= h.num_strings or
+        uint64_t(s.first_param) + s.num_params > h.num_vars or
+        uint64_t(s.first_var) + s.num_vars > h.num_vars or
+        uint64_t(s.first_instr) + s.num_instrs > h.num_instrs or
+        uint64_t(s.first_label) + s.num_labels > h.num_labels)
+      return false;
+    // each label names the LABEL instruction at its pc
+    unordered_map<uint32_t, uint32_t> labelPc;
+    vector<bool> atLabel(s.num_instrs, false);
+    for (uint32_t l = 0; l < s.num_labels; ++l) {
+      const tbcLabel &lab = labels[s.first_label + l];
+      if (lab.pc >= s.num_instrs) return false;
+      const tbcInstr &i = instrs[s.first_instr + lab.pc];
+      if (i.oper != instruction::_LABEL or i.kind[0] != operand::_LABEL or i.val[0] != lab.name)
+        return false;
+      labelPc.insert(make_pair(lab.name, lab.pc));
+      atLabel[lab.pc] = true;
+    }
+    for (uint32_t pc = 0; pc < s.num_instrs; ++pc) {
+      const tbcInstr &i = instrs[s.first_instr + pc];
+      if (i.oper >= instruction::_INVALID) return false;
+      for (int k = 0; k < 3; ++k) {
+        if (i.kind[k] > operand::_PC) return false;
+        if ((i.kind[k] == operand::_NAME or i.kind[k] == operand::_LABEL) and
+            i.val[k] >= h.num_strings)
+          return false;
+        if (i.kind[k] == operand::_PC and i.val[k] >= s.num_instrs) return false;
+      }
+      // UJUMP and FJUMP go to a label of the subroutine, and every jump
+      // carries the pc of a label (the one it names, if it has one)
+      if (i.oper == instruction::_UJUMP or i.oper == instruction::_FJUMP) {
+        int k = (i.oper == instruction::_UJUMP ? 0 : 1);
+        auto p = labelPc.find(i.val[k]);
+        if (i.kind[k] != operand::_LABEL or p == labelPc.end() or
+            i.kind[k+1] != operand::_PC or i.val[k+1] != p->second)
+          return false;
+      }
+      else if (instruction(instruction::Operation(i.oper)).is_compare_jump() and
+               (i.kind[2] != operand::_PC or not atLabel[i.val[2]]))
+        return false;
+    }
+  }
+  return true;
+}
+
+/// unmap the file
+void tbcImage::close() {
+  if (base) munmap((void *)base, length);
+  base = nullptr;
+  length = 0;
+  header = nullptr;
+}
+
+/// get sections
+size_t tbcImage::get_num_subroutines() const { return header ? header->num_subs : 0; }
+const tbcSub & tbcImage::get_subroutine(size_t i) const { return subs[i]; }
+const tbcVar * tbcImage::get_params(const tbcSub &s) const { return vars + s.first_param; }
+const tbcVar * tbcImage::get_vars(const tbcSub &s) const { return vars + s.first_var; }
+const tbcInstr * tbcImage::get_instructions(const tbcSub &s) const { return instrs + s.first_instr; }
+const tbcLabel * tbcImage::get_labels(const tbcSub &s) const { return labels + s.first_label; }
+/// get string from the string table
+const char * tbcImage::get_string(uint32_t i) const { return str_bytes + str_offsets[i]; }
+/// string constants
+size_t tbcImage::get_num_consts() const { return header ? header->num_consts : 0; }
+const uint32_t * tbcImage::get_consts() const { return consts; }
+
+/// intern all strings in the table
+vector<uint32_t> tbcImage::get_name_ids() const {
+  vector<uint32_t> ids;
+  ids.reserve(header->num_strings);
+  for (uint32_t i = 0; i < header->num_strings; ++i)
+    ids.push_back(nametable::intern(get_string(i)));
+  return ids;
+}
+
+/// decode one instruction
+instruction tbcImage::get_instruction(const tbcInstr &in, const std::vector<uint32_t> &ids) const {
+  operand args[3];
+  for (int k = 0; k < 3; ++k) {
+    uint32_t v = in.val[k];
+    switch (in.kind[k]) {
+    case operand::_TEMP : args[k] = operand::TEMP(v); break;
+    case operand::_NAME : args[k] = operand::NAME_ID(ids[v]); break;
+    case operand::_LABEL : args[k] = operand::LABEL_ID(ids[v]); break;
+    case operand::_INTCONST : args[k] = operand::INTCONST(int32_t(v)); break;
+    case operand::_FLOATCONST : { float f; memcpy(&f, &v, 4); args[k] = operand::FLOATCONST(f); break; }
+    case operand::_CHARCONST : args[k] = operand::CHARCONST(char(v)); break;
+    case operand::_PC : args[k] = operand::PC(v); break;
+    default : break;
+    }
+  }
+  return instruction(instruction::Operation(in.oper), args[0], args[1], args[2]);
+}
+
+/// build a 'code' object with the whole program
+code tbcImage::get_code() const {
+  code c;
+  vector<uint32_t> ids = get_name_ids();
+  for (size_t n = 0; n < get_num_subroutines(); ++n) {
+    const tbcSub &ts = get_subroutine(n);
+    subroutine s(get_string(ts.name));
+    for (uint32_t i = 0; i < ts.num_params; ++i)
+      s.add_param(get_string(get_params(ts)[i].name));
+    for (uint32_t i = 0; i < ts.num_vars; ++i)
+      s.add_var(get_string(get_vars(ts)[i].name), get_vars(ts)[i].size);
+    // compare-and-branch instructions only have the pc of their target:
+    // get their label back from the labels of the subroutine
+    unordered_map<uint32_t, uint32_t> labelAt;
+    for (uint32_t i = 0; i < ts.num_labels; ++i)
+      labelAt.insert(make_pair(get_labels(ts)[i].pc, ids[get_labels(ts)[i].name]));
+    const tbcInstr *ins = get_instructions(ts);
+    for (uint32_t pc = 0; pc < ts.num_instrs; ++pc) {
+      instruction i = get_instruction(ins[pc], ids);
+      if (i.is_compare_jump() and i.arg3.is_pc())
+        i.arg3 = operand::LABEL_ID(labelAt.at(i.arg3.get_pc()));
+      s.add_instruction(i);
+    }
+    s.finalize();
+    c.add_subroutine(s);
+  }
+  for (size_t n = 0; n < get_num_consts(); ++n) c.add_string(get_string(get_consts()[n]));
+  return c;
+}
@@ -0,0 +1,163 @@
+/////////////////////////////////////////////////////////////////
+//
+//    tbc - Binary t-code object files
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "code.h"
+
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+// A .tbc file holds a whole program in host byte order, as a
+// sequence of 4-byte aligned sections:
+//
+//   tbcHeader
+//   uint32_t  string offsets [num_strings+1]
+//   char      string bytes [string_bytes] (each one '\0' terminated)
+//   tbcSub    subroutines [num_subs]
+//   tbcVar    params and vars [num_vars]
+//   tbcInstr  instructions [num_instrs]
+//   tbcLabel  labels [num_labels]
+//   uint32_t  string constants [num_consts] (indexes in the string table)
+//
+// Names and labels in operands are indexes in the string table, and
+// jumps carry the program counter of their target, so a loader can
+// run the instruction array in place.
+
+/// version of the format, to be increased whenever the layout or the
+/// numbering of instruction::Operation / operand::Kind changes
+#define TBC_VERSION 4
+
+struct tbcHeader {
+  char     magic[4];       // "TBC\0"
+  uint32_t version;
+  uint32_t num_strings;
+  uint32_t string_bytes;   // including padding to a multiple of 4
+  uint32_t num_subs;
+  uint32_t num_vars;
+  uint32_t num_instrs;
+  uint32_t num_labels;
+  uint32_t num_consts;
+};
+
+struct tbcSub {
+  uint32_t name;
+  uint32_t first_param, num_params;   // in the var section
+  uint32_t first_var, num_vars;       // in the var section
+  uint32_t first_instr, num_instrs;
+  uint32_t first_label, num_labels;
+};
+
+struct tbcVar {
+  uint32_t name;
+  uint32_t size;
+};
+
+struct tbcInstr {
+  uint8_t  oper;      // instruction::Operation
+  uint8_t  kind[3];   // operand::Kind of each argument
+  uint32_t val[3];    // temp number, string index, pc, or immediate bits
+};
+
+struct tbcLabel {
+  uint32_t name;
+  uint32_t pc;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class tbcWriter serializes a program in .tbc format
+
+class tbcWriter {
+public:
+  // write given program to given (binary) stream
+  static void write(const code &c, std::ostream &os);
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class tbcImage maps a .tbc file in memory and gives direct access
+/// to its sections. The section accessors work in place, without
+/// copying or allocating; get_instruction and get_code decode into
+/// 'instruction' and 'code' objects
+
+class tbcImage {
+private:
+  /// mapped file
+  const char *base;
+  size_t length;
+  /// sections
+  const tbcHeader *header;
+  const uint32_t *str_offsets;
+  const char *str_bytes;
+  const tbcSub *subs;
+  const tbcVar *vars;
+  const tbcInstr *instrs;
+  const tbcLabel *labels;
+  const uint32_t *consts;
+
+  /// check that all sections and indexes are inside the file
+  bool check() const;
+
+  /// the mapping is owned by the object, so it can not be copied
+  tbcImage(const tbcImage &) = delete;
+  tbcImage & operator=(const tbcImage &) = delete;
+
+public:
+  /// constructor and destructor
+  tbcImage();
+  ~tbcImage();
+
+  /// map given file. Returns false if it can not be read or is not a
+  /// valid .tbc file of the current version
+  bool open(const std::string &fname);
+  /// unmap the file
+  void close();
+
+  /// get sections
+  size_t get_num_subroutines() const;
+  const tbcSub & get_subroutine(size_t i) const;
+  const tbcVar * get_vars(const tbcSub &s) const;
+  const tbcVar * get_params(const tbcSub &s) const;
+  const tbcInstr * get_instructions(const tbcSub &s) const;
+  const tbcLabel * get_labels(const tbcSub &s) const;
+  /// get string from the string table
+  const char * get_string(uint32_t i) const;
+  /// string constants, as indexes in the string table
+  size_t get_num_consts() const;
+  const uint32_t * get_consts() const;
+
+  /// decode one instruction; 'ids' maps string indexes to nametable
+  /// ids (see get_name_ids)
+  instruction get_instruction(const tbcInstr &in, const std::vector<uint32_t> &ids) const;
+  /// intern all strings in the table, returning their nametable ids
+  std::vector<uint32_t> get_name_ids() const;
+
+  /// build a 'code' object with the whole program (jumps resolved).
+  /// This copies every instruction out of the mapping: it saves the
+  /// parsing of a text file, not the allocation per instruction
+  code get_code() const;
+};
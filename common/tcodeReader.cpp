@@ -0,0 +1,482 @@
+/////////////////////////////////////////////////////////////////
+//
+//    tcodeReader - Parser for textual t-code
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#include "tcodeReader.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cctype>
+
+using namespace std;
+
+static bool is_ident_start(char c) { return isalpha((unsigned char)c) or c == '_'; }
+static bool is_ident_char(char c) { return isalnum((unsigned char)c) or c == '_'; }
+static bool is_digit(char c) { return c >= '0' and c <= '9'; }
+
+/// instructions introduced by a keyword
+static const struct { const char *word; instruction::Operation oper; } keywordInstrs[] = {
+  {"label", instruction::_LABEL},     {"goto", instruction::_UJUMP},
+  {"ifFalse", instruction::_FJUMP},   {"if", instruction::_IFEQ},
+  {"pushparam", instruction::_PUSH},
+  {"popparam", instruction::_POP},    {"call", instruction::_CALL},
+  {"return", instruction::_RETURN},   {"readi", instruction::_READI},
+  {"readf", instruction::_READF},     {"readc", instruction::_READC},
+  {"writei", instruction::_WRITEI},   {"writef", instruction::_WRITEF},
+  {"writec", instruction::_WRITEC},   {"writeln", instruction::_WRITELN},
+  {"writes", instruction::_WRITES},
+  {"acopy", instruction::_ACOPY},     {"noop", instruction::_NOOP}
+};
+
+/// binary operators in "a1 = a2 op a3" (longest spelling first)
+static const struct { const char *word; instruction::Operation oper; } binaryOps[] = {
+  {"==.", instruction::_FEQ}, {"==", instruction::_EQ},
+  {"<=.", instruction::_FLE}, {"<=", instruction::_LE},
+  {"<.", instruction::_FLT},  {"<", instruction::_LT},
+  {"+.", instruction::_FADD}, {"+", instruction::_ADD},
+  {"-.", instruction::_FSUB}, {"-", instruction::_SUB},
+  {"*.", instruction::_FMUL}, {"*", instruction::_MUL},
+  {"/.", instruction::_FDIV}, {"/", instruction::_DIV},
+  {"and", instruction::_AND}, {"or", instruction::_OR}
+};
+
+/// comparisons in "if a1 op a2 goto a3" and "ifFalse a1 op a2 goto a3"
+static const struct { const char *word; instruction::Operation ifTrue, ifFalse; } compareJumps[] = {
+  {"==.", instruction::_IFFEQ, instruction::_IFFNEQ}, {"==", instruction::_IFEQ, instruction::_IFNEQ},
+  {"<=.", instruction::_IFFLE, instruction::_IFFNLE}, {"<=", instruction::_IFLE, instruction::_IFNLE},
+  {"<.", instruction::_IFFLT, instruction::_IFFNLT},  {"<", instruction::_IFLT, instruction::_IFNLT}
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'tcodeReader'
+
+/// constructor
+tcodeReader::tcodeReader() : p(nullptr), end(nullptr), line(0) {}
+
+/// message for the error that stopped the parser
+const string & tcodeReader::get_error() const { return error; }
+
+/// record an error message
+bool tcodeReader::fail(const string &msg) {
+  error = "line " + to_string(line) + ": " + msg;
+  return false;
+}
+
+/// skip blanks and ;;; comments up to the end of the line
+void tcodeReader::skip_blanks() {
+  while (p < end) {
+    if (*p == ' ' or *p == '\t' or *p == '\r') ++p;
+    else if (end - p >= 3 and p[0] == ';' and p[1] == ';' and p[2] == ';') {
+      while (p < end and *p != '\n') ++p;
+    }
+    else break;
+  }
+}
+
+/// skip blank or comment-only lines. Returns false at end of text
+bool tcodeReader::skip_empty_lines() {
+  while (true) {
+    skip_blanks();
+    if (p == end) return false;
+    if (*p != '\n') return true;
+    ++p;
+    ++line;
+  }
+}
+
+/// check that only blanks/comments remain in the line, and move to the next one
+bool tcodeReader::end_of_line() {
+  skip_blanks();
+  if (p == end) return true;
+  if (*p != '\n') return fail("unexpected '" + string(1, *p) + "'");
+  ++p;
+  ++line;
+  return true;
+}
+
+/// check whether the next token is the given symbol
+bool tcodeReader::at(char ch) const { return p < end and *p == ch; }
+
+/// check whether the next token is the given word or symbol
+bool tcodeReader::at_word(const char *w) const {
+  size_t n = strlen(w);
+  if (size_t(end - p) < n or memcmp(p, w, n) != 0) return false;
+  // a keyword must not be the prefix of a longer name
+  return not (is_ident_char(w[0]) and p + n < end and is_ident_char(p[n]));
+}
+
+/// consume given word or symbol, or fail
+bool tcodeReader::expect(const char *w) {
+  if (not at_word(w)) return fail("expected '" + string(w) + "'");
+  p += strlen(w);
+  skip_blanks();
+  return true;
+}
+
+/// read an identifier and return its nametable id
+bool tcodeReader::read_ident(uint32_t &id) {
+  if (p == end or not is_ident_start(*p)) return fail("expected a name");
+  const char *q = p;
+  while (q < end and is_ident_char(*q)) ++q;
+  id = nametable::intern(string(p, q));
+  p = q;
+  skip_blanks();
+  return true;
+}
+
+/// read an unsigned integer of up to 32 bits (temporals and sizes)
+bool tcodeReader::read_size(size_t &n) {
+  if (p == end or not is_digit(*p)) return fail("expected a number");
+  n = 0;
+  while (p < end and is_digit(*p)) {
+    n = n*10 + (*p++ - '0');
+    if (n > UINT32_MAX) return fail("number out of range");
+  }
+  skip_blanks();
+  return true;
+}
+
+/// read an operand (temporal, name, or immediate)
+bool tcodeReader::read_operand(operand &o) {
+  if (p == end or *p == '\n') return fail("missing operand");
+  char ch = *p;
+  if (ch == '%') {
+    ++p;
+    size_t n;
+    if (not read_size(n)) return false;
+    o = operand::TEMP(n);
+    return true;
+  }
+  if (is_digit(ch) or (ch == '-' and p + 1 < end and is_digit(p[1]))) {
+    const char *q = p + 1;
+    while (q < end and is_digit(*q)) ++q;
+    bool isfloat = (q < end and *q == '.');
+    if (isfloat) {
+      ++q;
+      while (q < end and is_digit(*q)) ++q;
+    }
+    string num(p, q);
+    if (isfloat) o = operand::FLOATCONST(strtof(num.c_str(), nullptr));
+    else {
+      long long v = strtoll(num.c_str(), nullptr, 10);
+      if (v < INT32_MIN or v > INT32_MAX) return fail("integer " + num + " out of range");
+      o = operand::INTCONST(int32_t(v));
+    }
+    p = q;
+    skip_blanks();
+    return true;
+  }
+  if (ch == '\'') {
+    ++p;
+    if (p == end or *p == '\n') return fail("unterminated character");
+    char c = *p++;
+    if (c == '\\' and p < end) {
+      c = *p++;
+      if (c == 'n') c = '\n';
+      else if (c == 't') c = '\t';
+    }
+    if (not at('\'')) return fail("unterminated character");
+    ++p;
+    o = operand::CHARCONST(c);
+    skip_blanks();
+    return true;
+  }
+  uint32_t id;
+  if (not read_ident(id)) return fail("unexpected '" + string(1, ch) + "'");
+  o = operand::NAME_ID(id);
+  return true;
+}
+
+/// read one instruction line and add it to the subroutine
+bool tcodeReader::read_instruction(subroutine &s) {
+  instruction::Operation oper = instruction::_INVALID;
+  operand a1, a2, a3;
+  uint32_t id;
+
+  // a leading keyword introduces an instruction, unless it is a
+  // variable being assigned ("goto = 1" or "call[i] = x")
+  if (is_ident_start(*p)) {
+    const char *q = p;
+    while (q < end and is_ident_char(*q)) ++q;
+    const char *r = q;
+    while (r < end and (*r == ' ' or *r == '\t' or *r == '\r')) ++r;
+    if (not (r < end and (*r == '=' or *r == '['))) {
+      for (auto &k : keywordInstrs) {
+        if (size_t(q - p) == strlen(k.word) and memcmp(p, k.word, q - p) == 0) {
+          oper = k.oper;
+          break;
+        }
+      }
+      if (oper == instruction::_INVALID) return fail("unknown instruction '" + string(p, q) + "'");
+      p = q;
+      skip_blanks();
+    }
+  }
+
+  switch (oper) {
+  case instruction::_LABEL :
+    if (not read_ident(id) or not expect(":")) return false;
+    a1 = operand::LABEL_ID(id);
+    if (s.has_label(a1)) return fail("label '" + a1.get_name() + "' defined twice");
+    break;
+  case instruction::_UJUMP :
+    if (not read_ident(id)) return false;
+    a1 = operand::LABEL_ID(id);
+    break;
+  case instruction::_FJUMP :
+  case instruction::_IFEQ : {
+    // "ifFalse a1 goto a2", or compare-and-branch "if/ifFalse a1 op a2 goto a3"
+    bool jumpIf = (oper == instruction::_IFEQ);
+    if (not read_operand(a1)) return false;
+    if (not jumpIf and at_word("goto")) {
+      if (not expect("goto") or not read_ident(id)) return false;
+      a2 = operand::LABEL_ID(id);
+      break;
+    }
+    oper = instruction::_INVALID;
+    for (auto &c : compareJumps) {
+      if (at_word(c.word)) {
+        oper = (jumpIf ? c.ifTrue : c.ifFalse);
+        p += strlen(c.word);
+        skip_blanks();
+        break;
+      }
+    }
+    if (oper == instruction::_INVALID) return fail("expected a comparison");
+    if (not read_operand(a2) or not expect("goto") or not read_ident(id)) return false;
+    a3 = operand::LABEL_ID(id);
+    break;
+  }
+  case instruction::_PUSH :
+  case instruction::_POP :
+    if (p < end and *p != '\n' and not read_operand(a1)) return false;
+    break;
+  case instruction::_CALL :
+    if (not read_ident(id)) return false;
+    a1 = operand::NAME_ID(id);
+    break;
+  case instruction::_READI : case instruction::_READF : case instruction::_READC :
+  case instruction::_WRITEI : case instruction::_WRITEF : case instruction::_WRITEC :
+  case instruction::_WRITES :
+    if (not read_operand(a1)) return false;
+    break;
+  case instruction::_ACOPY :
+    if (not read_operand(a1) or not read_operand(a2) or not read_operand(a3)) return false;
+    break;
+  case instruction::_RETURN :
+  case instruction::_WRITELN :
+  case instruction::_NOOP :
+    break;
+
+  default :
+    // assignments: "*a1 = a2", "a1[a2] = a3" or "a1 = <expression>"
+    if (at('*')) {
+      ++p;
+      skip_blanks();
+      if (not read_operand(a1) or not expect("=") or not read_operand(a2)) return false;
+      oper = instruction::_CLOAD;
+      break;
+    }
+    if (not read_operand(a1)) return false;
+    if (a1.is_const()) return fail("can not assign to a constant");
+    if (at('[')) {
+      ++p;
+      skip_blanks();
+      if (not read_operand(a2) or not expect("]") or not expect("=") or not read_operand(a3))
+        return false;
+      oper = instruction::_XLOAD;
+      break;
+    }
+    if (not expect("=")) return false;
+
+    // unary forms
+    if (at('&')) oper = instruction::_ALOAD;
+    else if (at('*')) oper = instruction::_LOADC;
+    else if (at('-') and not (p + 1 < end and is_digit(p[1])))
+      oper = (p + 1 < end and p[1] == '.') ? instruction::_FNEG : instruction::_NEG;
+    else if (at_word("not")) oper = instruction::_NOT;
+    else if (at_word("float")) oper = instruction::_FLOAT;
+    if (oper != instruction::_INVALID) {
+      p += (oper == instruction::_NOT ? 3 : oper == instruction::_FLOAT ? 5 :
+            oper == instruction::_FNEG ? 2 : 1);
+      skip_blanks();
+      if (not read_operand(a2)) return false;
+      break;
+    }
+
+    if (not read_operand(a2)) return false;
+    // copy or immediate load
+    if (p == end or *p == '\n') {
+      switch (a2.get_kind()) {
+      case operand::_INTCONST : oper = instruction::_ILOAD; break;
+      case operand::_FLOATCONST : oper = instruction::_FLOAD; break;
+      case operand::_CHARCONST : oper = instruction::_CHLOAD; break;
+      default : oper = instruction::_LOAD; break;
+      }
+      break;
+    }
+    // indexed load
+    if (at('[')) {
+      ++p;
+      skip_blanks();
+      if (not read_operand(a3) or not expect("]")) return false;
+      oper = instruction::_LOADX;
+      break;
+    }
+    // binary operation
+    for (auto &b : binaryOps) {
+      if (at_word(b.word)) {
+        oper = b.oper;
+        p += strlen(b.word);
+        skip_blanks();
+        break;
+      }
+    }
+    if (oper == instruction::_INVALID) return fail("unknown operator '" + string(1, *p) + "'");
+    if (not read_operand(a3)) return false;
+    break;
+  }
+
+  s.add_instruction(instruction(oper, a1, a2, a3));
+  return end_of_line();
+}
+
+/// read the body of "function <name>" up to endfunction
+bool tcodeReader::read_subroutine(const string &name, code &c) {
+  subroutine s(name);
+  uint32_t id;
+  size_t sz;
+  if (not end_of_line()) return false;
+
+  while (true) {
+    if (not skip_empty_lines()) return fail("missing 'endfunction' in function " + name);
+    if (at_word("endfunction")) {
+      if (not expect("endfunction") or not end_of_line()) return false;
+      break;
+    }
+    // "params" and "vars" blocks (unless they are variables being assigned)
+    bool isparams = at_word("params");
+    bool isvars = at_word("vars");
+    if (isparams or isvars) {
+      const char *r = p + (isparams ? 6 : 4);
+      while (r < end and (*r == ' ' or *r == '\t' or *r == '\r')) ++r;
+      if (r < end and (*r == '=' or *r == '[')) isparams = isvars = false;
+    }
+    if (isparams) {
+      if (not expect("params") or not end_of_line()) return false;
+      while (true) {
+        if (not skip_empty_lines()) return fail("missing 'endparams'");
+        if (at_word("endparams")) break;
+        if (not read_ident(id)) return false;
+        s.add_param(nametable::get(id));
+        if (not end_of_line()) return false;
+      }
+      if (not expect("endparams") or not end_of_line()) return false;
+    }
+    else if (isvars) {
+      if (not expect("vars") or not end_of_line()) return false;
+      while (true) {
+        if (not skip_empty_lines()) return fail("missing 'endvars'");
+        if (at_word("endvars")) break;
+        if (not read_ident(id) or not read_size(sz)) return false;
+        s.add_var(nametable::get(id), sz);
+        if (not end_of_line()) return false;
+      }
+      if (not expect("endvars") or not end_of_line()) return false;
+    }
+    else if (not read_instruction(s))
+      return false;
+  }
+
+  for (auto &i : s.get_instructions()) {
+    if (i.is_jump() and not s.has_label(i.get_jump_label()))
+      return fail("undefined label '" + i.get_jump_label().get_name() + "' in function " + name);
+  }
+  s.finalize();
+  c.add_subroutine(s);
+  return true;
+}
+
+/// read the string constants, "strings" up to endstrings. Each line
+/// holds the index of the string (in order) and the quoted text
+bool tcodeReader::read_strings(code &c) {
+  size_t n;
+  if (not expect("strings") or not end_of_line()) return false;
+  while (true) {
+    if (not skip_empty_lines()) return fail("missing 'endstrings'");
+    if (at_word("endstrings")) break;
+    if (not read_size(n)) return false;
+    if (n != c.get_strings().size()) return fail("string " + to_string(n) + " out of order");
+    if (not at('"')) return fail("expected a string");
+    string text;
+    for (++p; p < end and *p != '"' and *p != '\n'; ++p) {
+      char ch = *p;
+      if (ch == '\\' and p + 1 < end and p[1] != '\n') {
+        ch = *++p;
+        if (ch == 'n') ch = '\n';
+        else if (ch == 't') ch = '\t';
+      }
+      text += ch;
+    }
+    if (not at('"')) return fail("unterminated string");
+    ++p;
+    if (c.add_string(text) != n) return fail("string " + to_string(n) + " repeats an earlier one");
+    if (not end_of_line()) return false;
+  }
+  return expect("endstrings") and end_of_line();
+}
+
+/// parse given text, adding its subroutines to 'c'
+bool tcodeReader::parse(const char *text, size_t len, code &c) {
+  p = text;
+  end = text + len;
+  line = 1;
+  error.clear();
+  uint32_t id;
+  while (skip_empty_lines()) {
+    if (at_word("strings")) {
+      if (not read_strings(c)) return false;
+      continue;
+    }
+    if (not expect("function") or not read_ident(id)) return false;
+    if (not read_subroutine(nametable::get(id), c)) return false;
+  }
+  return true;
+}
+
+bool tcodeReader::parse(const string &text, code &c) { return parse(text.data(), text.size(), c); }
+
+/// parse given file
+bool tcodeReader::read(const string &fname, code &c) {
+  ifstream in(fname, ios::in | ios::binary);
+  if (not in) {
+    error = "can not open file " + fname;
+    return false;
+  }
+  in.seekg(0, ios::end);
+  string text(size_t(in.tellg()), '\0');
+  in.seekg(0, ios::beg);
+  in.read(&text[0], text.size());
+  return parse(text, c);
+}
@@ -0,0 +1,87 @@
+/////////////////////////////////////////////////////////////////
+//
+//    tcodeReader - Parser for textual t-code
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "code.h"
+
+#include <string>
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////
+/// Class tcodeReader loads a program in textual t-code (as printed by
+/// code::dump, or written by hand as in tvm/examples) into a 'code'
+/// object. The text is scanned once, line by line, deciding each
+/// instruction form from its first tokens without backtracking.
+/// Subroutines are finalized (jumps resolved) as they are read, and
+/// string constants are read from a "strings" section.
+
+class tcodeReader {
+private:
+  /// current position in the text, and end of the text
+  const char *p, *end;
+  /// current line number (for error messages)
+  size_t line;
+  /// message for the first error found
+  std::string error;
+
+  /// skip blanks and ;;; comments up to the end of the line
+  void skip_blanks();
+  /// skip blank or comment-only lines. Returns false at end of text
+  bool skip_empty_lines();
+  /// check that only blanks/comments remain in the line, and move to the next one
+  bool end_of_line();
+  /// check whether the next token is the given word or symbol
+  bool at_word(const char *w) const;
+  bool at(char ch) const;
+  /// consume given word or symbol, or fail
+  bool expect(const char *w);
+  /// read an identifier and return its nametable id
+  bool read_ident(uint32_t &id);
+  /// read an unsigned integer of up to 32 bits
+  bool read_size(size_t &n);
+  /// read an operand (temporal, name, or immediate)
+  bool read_operand(operand &o);
+  /// read one instruction line and add it to the subroutine
+  bool read_instruction(subroutine &s);
+  /// read the body of "function <name>" up to endfunction
+  bool read_subroutine(const std::string &name, code &c);
+  /// read the string constants, "strings" up to endstrings
+  bool read_strings(code &c);
+  /// record an error message
+  bool fail(const std::string &msg);
+
+public:
+  /// constructor
+  tcodeReader();
+
+  /// parse given text, adding its subroutines to 'c'. Returns false
+  /// (see get_error) if the text is not valid t-code
+  bool parse(const char *text, size_t len, code &c);
+  bool parse(const std::string &text, code &c);
+  /// parse given file
+  bool read(const std::string &fname, code &c);
+
+  /// message for the error that stopped the parser ("line N: ...")
+  const std::string & get_error() const;
+};
@@ -0,0 +1,91 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Main program - Interpreter for t-code programs. It loads
+//                   a textual (.t) or binary (.tbc) program and
+//                   runs it, like tvm
+//
+//    Copyright (C) 2019  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluís Padró (padro@cs.upc.edu)
+//             José Miguel Rivero (rivero@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.110 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+
+#include "../common/code.h"
+#include "../common/tbc.h"
+#include "../common/tcodeReader.h"
+#include "../common/Interpreter.h"
+
+#include <iostream>
+#include <string>
+
+#include <cstdlib>    // EXIT_FAILURE, EXIT_SUCCESS
+
+
+int main(int argc, const char* argv[]) {
+  std::ios::sync_with_stdio(false);
+
+  // check the correct use of the program
+  //   --stack=N   number of cells in the stack
+  size_t cells = interpreter::STACK_CELLS;
+  const char *fname = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 8, "--stack=") == 0 and arg.size() > 8 and
+        arg.find_first_not_of("0123456789", 8) == std::string::npos)
+      cells = std::stoul(arg.substr(8));
+    else if (not fname and arg[0] != '-')
+      fname = argv[i];
+    else {
+      std::cout << "Usage: ./tvmi [--stack=N] <file.t|file.tbc>" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (not fname) {
+    std::cout << "Usage: ./tvmi [--stack=N] <file.t|file.tbc>" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // a valid .tbc file is mapped, anything else is read as text. The
+  // interpreter works on a 'code' object, so the mapped instructions
+  // are copied into one: only the parsing is saved, not the copy
+  code program;
+  tbcImage image;
+  if (image.open(fname))
+    program = image.get_code();
+  else {
+    tcodeReader reader;
+    if (not reader.read(fname, program)) {
+      std::cerr << fname << ": " << reader.get_error() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  interpreter vm(program, cells);
+  bool ok = vm.run(std::cin, std::cout);
+  std::cout.flush();
+  if (not ok) {
+    std::cerr << "Runtime error: " << vm.get_error() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}